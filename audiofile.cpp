@@ -1276,6 +1276,259 @@ Audio::Error AudioFile::setMinimum(unsigned long samples)
     return errSuccess;
 }
 
+// linear conversion kernels for getLinear/putLinear.  Any linear file
+// encoding is converted to or from 16 bit host order mono through a
+// fixed chunk on the stack: wider or narrower samples keep their high
+// bits, foreign byte order is swapped, and stereo is averaged down to
+// mono on read and duplicated on write.  8 bit samples are unsigned in
+// riff/wave files and signed elsewhere.
+
+#define LINEAR_CHUNK    512
+
+#if defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+#define LINEAR_SSE2
+#include <emmintrin.h>
+#endif
+
+static unsigned linear_frame(Audio::Encoding encoding)
+{
+    switch(encoding) {
+    case Audio::pcm8Mono:
+        return 1;
+    case Audio::pcm8Stereo:
+    case Audio::pcm16Mono:
+    case Audio::cdaMono:
+        return 2;
+    case Audio::pcm16Stereo:
+    case Audio::cdaStereo:
+    case Audio::pcm32Mono:
+        return 4;
+    case Audio::pcm32Stereo:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+static inline Audio::snd16_t linear_swap16(Audio::snd16_t value)
+{
+    return (Audio::snd16_t)(((unsigned short)value >> 8) | ((unsigned short)value << 8));
+}
+
+static inline Audio::snd32_t linear_swap32(Audio::snd32_t value)
+{
+    uint32_t bits = (uint32_t)value;
+
+    return (Audio::snd32_t)((bits >> 24) | ((bits >> 8) & 0xff00) |
+        ((bits << 8) & 0xff0000) | (bits << 24));
+}
+
+#ifdef  LINEAR_SSE2
+static inline __m128i linear_swap16_sse2(__m128i x)
+{
+    return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+
+static inline __m128i linear_swap32_sse2(__m128i x)
+{
+    x = linear_swap16_sse2(x);
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xb1), 0xb1);
+}
+#endif
+
+static void linear_import8(Audio::Linear dest, const unsigned char *src, unsigned frames, bool stereo, bool offset)
+{
+    unsigned pos = 0;
+    int left, right;
+
+#ifdef  LINEAR_SSE2
+    const __m128i flip = _mm_set1_epi8(offset ? (char)0x80 : 0);
+    __m128i x;
+
+    if(stereo) {
+        for(; pos + 8 <= frames; pos += 8) {
+            x = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(src + pos * 2)), flip);
+            x = _mm_add_epi16(_mm_srai_epi16(_mm_slli_epi16(x, 8), 8), _mm_srai_epi16(x, 8));
+            _mm_storeu_si128((__m128i *)(dest + pos), _mm_slli_epi16(_mm_srai_epi16(x, 1), 8));
+        }
+    }
+    else {
+        for(; pos + 16 <= frames; pos += 16) {
+            x = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(src + pos)), flip);
+            _mm_storeu_si128((__m128i *)(dest + pos), _mm_unpacklo_epi8(_mm_setzero_si128(), x));
+            _mm_storeu_si128((__m128i *)(dest + pos + 8), _mm_unpackhi_epi8(_mm_setzero_si128(), x));
+        }
+    }
+#endif
+
+    for(; pos < frames; ++pos) {
+        if(stereo) {
+            left = offset ? src[pos * 2] - 128 : (signed char)src[pos * 2];
+            right = offset ? src[pos * 2 + 1] - 128 : (signed char)src[pos * 2 + 1];
+            left = (left + right) >> 1;
+        }
+        else
+            left = offset ? src[pos] - 128 : (signed char)src[pos];
+        dest[pos] = (Audio::Sample)(left * 256);
+    }
+}
+
+static void linear_import16(Audio::Linear dest, const Audio::snd16_t *src, unsigned frames, bool stereo, bool swap)
+{
+    unsigned pos = 0;
+    int left, right;
+
+#ifdef  LINEAR_SSE2
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i x, y;
+
+    if(stereo) {
+        for(; pos + 8 <= frames; pos += 8) {
+            x = _mm_loadu_si128((const __m128i *)(src + pos * 2));
+            y = _mm_loadu_si128((const __m128i *)(src + pos * 2 + 8));
+            if(swap) {
+                x = linear_swap16_sse2(x);
+                y = linear_swap16_sse2(y);
+            }
+            x = _mm_srai_epi32(_mm_madd_epi16(x, ones), 1);
+            y = _mm_srai_epi32(_mm_madd_epi16(y, ones), 1);
+            _mm_storeu_si128((__m128i *)(dest + pos), _mm_packs_epi32(x, y));
+        }
+    }
+    else if(swap) {
+        for(; pos + 8 <= frames; pos += 8) {
+            x = _mm_loadu_si128((const __m128i *)(src + pos));
+            _mm_storeu_si128((__m128i *)(dest + pos), linear_swap16_sse2(x));
+        }
+    }
+#endif
+
+    if(!stereo && !swap) {
+        memcpy(dest + pos, src + pos, (frames - pos) * 2);
+        return;
+    }
+
+    for(; pos < frames; ++pos) {
+        if(stereo) {
+            left = swap ? linear_swap16(src[pos * 2]) : src[pos * 2];
+            right = swap ? linear_swap16(src[pos * 2 + 1]) : src[pos * 2 + 1];
+            dest[pos] = (Audio::Sample)((left + right) >> 1);
+        }
+        else
+            dest[pos] = linear_swap16(src[pos]);
+    }
+}
+
+static void linear_import32(Audio::Linear dest, const Audio::snd32_t *src, unsigned frames, bool stereo, bool swap)
+{
+    unsigned pos = 0;
+    int left, right;
+
+#ifdef  LINEAR_SSE2
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i x[4];
+    unsigned load;
+
+    if(stereo) {
+        for(; pos + 8 <= frames; pos += 8) {
+            for(load = 0; load < 4; ++load) {
+                x[load] = _mm_loadu_si128((const __m128i *)(src + pos * 2 + load * 4));
+                if(swap)
+                    x[load] = linear_swap32_sse2(x[load]);
+                x[load] = _mm_srai_epi32(x[load], 16);
+            }
+            x[0] = _mm_srai_epi32(_mm_madd_epi16(_mm_packs_epi32(x[0], x[1]), ones), 1);
+            x[2] = _mm_srai_epi32(_mm_madd_epi16(_mm_packs_epi32(x[2], x[3]), ones), 1);
+            _mm_storeu_si128((__m128i *)(dest + pos), _mm_packs_epi32(x[0], x[2]));
+        }
+    }
+    else {
+        for(; pos + 8 <= frames; pos += 8) {
+            for(load = 0; load < 2; ++load) {
+                x[load] = _mm_loadu_si128((const __m128i *)(src + pos + load * 4));
+                if(swap)
+                    x[load] = linear_swap32_sse2(x[load]);
+                x[load] = _mm_srai_epi32(x[load], 16);
+            }
+            _mm_storeu_si128((__m128i *)(dest + pos), _mm_packs_epi32(x[0], x[1]));
+        }
+    }
+#endif
+
+    for(; pos < frames; ++pos) {
+        if(stereo) {
+            left = (swap ? linear_swap32(src[pos * 2]) : src[pos * 2]) >> 16;
+            right = (swap ? linear_swap32(src[pos * 2 + 1]) : src[pos * 2 + 1]) >> 16;
+            dest[pos] = (Audio::Sample)((left + right) >> 1);
+        }
+        else
+            dest[pos] = (Audio::Sample)((swap ? linear_swap32(src[pos]) : src[pos]) >> 16);
+    }
+}
+
+static void linear_import(Audio::Info &info, Audio::Linear dest, const void *src, unsigned frames)
+{
+    bool stereo = Audio::is_stereo(info.encoding);
+    bool swap = !Audio::is_endian(info);
+
+    switch(linear_frame(info.encoding) / (stereo ? 2 : 1)) {
+    case 1:
+        linear_import8(dest, (const unsigned char *)src, frames, stereo,
+            info.format == Audio::riff || info.format == Audio::wave);
+        break;
+    case 2:
+        linear_import16(dest, (const Audio::snd16_t *)src, frames, stereo, swap);
+        break;
+    case 4:
+        linear_import32(dest, (const Audio::snd32_t *)src, frames, stereo, swap);
+        break;
+    }
+}
+
+// the write side only narrows, widens or duplicates, which compilers
+// already vectorize from plain loops.
+
+static void linear_export(Audio::Info &info, void *dest, Audio::Linear src, unsigned frames)
+{
+    bool stereo = Audio::is_stereo(info.encoding);
+    bool swap = !Audio::is_endian(info);
+    unsigned char *d8 = (unsigned char *)dest;
+    Audio::snd16_t *d16 = (Audio::snd16_t *)dest;
+    Audio::snd32_t *d32 = (Audio::snd32_t *)dest;
+    unsigned pos, step = stereo ? 2 : 1;
+    unsigned char flip = (info.format == Audio::riff || info.format == Audio::wave) ? 0x80 : 0;
+    Audio::snd16_t s16;
+    Audio::snd32_t s32;
+
+    switch(linear_frame(info.encoding) / step) {
+    case 1:
+        for(pos = 0; pos < frames; ++pos) {
+            d8[pos * step] = (unsigned char)(src[pos] >> 8) ^ flip;
+            if(stereo)
+                d8[pos * 2 + 1] = d8[pos * 2];
+        }
+        break;
+    case 2:
+        for(pos = 0; pos < frames; ++pos) {
+            s16 = swap ? linear_swap16(src[pos]) : src[pos];
+            d16[pos * step] = s16;
+            if(stereo)
+                d16[pos * 2 + 1] = s16;
+        }
+        break;
+    case 4:
+        for(pos = 0; pos < frames; ++pos) {
+            s32 = (Audio::snd32_t)((uint32_t)(unsigned short)src[pos] << 16);
+            if(swap)
+                s32 = linear_swap32(s32);
+            d32[pos * step] = s32;
+            if(stereo)
+                d32[pos * 2 + 1] = s32;
+        }
+        break;
+    }
+}
+
 unsigned AudioFile::getLinear(Linear addr, unsigned samples)
 {
     unsigned rts = 0;
@@ -1292,6 +1545,34 @@ unsigned AudioFile::getLinear(Linear addr, unsigned samples)
         return count / 2;
     }
 
+    if(linear_frame(info.encoding)) {
+        snd32_t chunk[LINEAR_CHUNK];
+        unsigned frame = linear_frame(info.encoding);
+        unsigned request, partial;
+
+        while(rts < samples) {
+            request = samples - rts;
+            if(request > sizeof(chunk) / frame)
+                request = sizeof(chunk) / frame;
+
+            count = getBuffer((Encoded)chunk, request * frame);
+            if(count < 1)
+                break;
+
+            // a short read can end inside a frame; step back over those
+            // bytes so the next read starts with the whole frame.
+            partial = (unsigned)count % frame;
+            if(partial)
+                afSeek(getAbsolutePosition() - partial);
+
+            linear_import(info, addr + rts, chunk, count / frame);
+            rts += count / frame;
+            if((unsigned)count < request * frame)
+                break;
+        }
+        return rts;
+    }
+
     codec = getCodec();
     if(!codec)
         return 0;
@@ -1327,6 +1608,29 @@ unsigned AudioFile::putLinear(Linear addr, unsigned samples)
             return 0;
         return count / 2;
     }
+
+    if(linear_frame(info.encoding)) {
+        snd32_t chunk[LINEAR_CHUNK];
+        unsigned frame = linear_frame(info.encoding);
+        unsigned request, rts = 0;
+
+        while(rts < samples) {
+            request = samples - rts;
+            if(request > sizeof(chunk) / frame)
+                request = sizeof(chunk) / frame;
+
+            linear_export(info, chunk, addr + rts, request);
+            count = putBuffer((Encoded)chunk, request * frame);
+            if(count < (int)frame)
+                break;
+
+            rts += count / frame;
+            if((unsigned)count < request * frame)
+                break;
+        }
+        return rts;
+    }
+
     codec = getCodec();
     if(!codec)
         return 0;
@@ -46,18 +46,44 @@ extern "C" {
 
 namespace ucommon {
 
+// encoding-indexed cache of the codec list.  The base constructor runs
+// before the codec is complete, so a slot is only filled by the first
+// lookup that walks the list, and published with a release store that
+// lookups read back with an acquire load.  A later registration clears
+// its slot, so the next lookup finds the newest codec as the walk did.
+// The list head is likewise stored with release once the codec fields
+// are set, and read back with acquire before walking the list.  Without atomic builtins every lookup walks the list.
+
+#define CODEC_INDEX 64
+
 static LinkedObject *first = NULL;
+static AudioCodec *registry[CODEC_INDEX];
+
+#ifdef  __GNUC__
+#define CODEC_LOOKUP(e)         __atomic_load_n(&registry[e], __ATOMIC_ACQUIRE)
+#define CODEC_PUBLISH(e, c)     __atomic_store_n(&registry[e], c, __ATOMIC_RELEASE)
+#define CODEC_FIRST             __atomic_load_n(&first, __ATOMIC_ACQUIRE)
+#define CODEC_HEAD(c)           __atomic_store_n(&first, c, __ATOMIC_RELEASE)
+#else
+#define CODEC_LOOKUP(e)         ((AudioCodec *)NULL)
+#define CODEC_PUBLISH(e, c)     ((void)0)
+#define CODEC_FIRST             first
+#define CODEC_HEAD(c)           (first = (c))
+#endif
 
 AudioCodec::AudioCodec(const char *n, Encoding e) :
 LinkedObject(&first)
 {
     encoding = e;
     name = n;
-    first = this;
 
     info.clear();
     info.format = raw;
     info.encoding = e;
+
+    CODEC_HEAD((LinkedObject *)this);
+    if((unsigned)e < CODEC_INDEX)
+        CODEC_PUBLISH(e, (AudioCodec *)NULL);
 }
 
 AudioCodec::AudioCodec()
@@ -68,47 +94,110 @@ AudioCodec::AudioCodec()
     info.format = raw;
 }
 
+// released instances of stateful codecs are kept on a freelist per
+// encoding, and handed back out by getByInfo/getByFormat after reset().
+// Each freelist holds at most CODEC_POOL instances, so a burst of calls
+// does not pin its peak codec count for the life of the process.
+
+#define CODEC_POOL  32
+
+static LinkedObject *pools[CODEC_INDEX];
+static unsigned pooled[CODEC_INDEX];
+static Mutex pool_lock;
+
+static AudioCodec *reuse(Audio::Encoding e)
+{
+    AudioCodec *codec;
+
+    if((unsigned)e >= CODEC_INDEX)
+        return NULL;
+
+    pool_lock.lock();
+    codec = (AudioCodec *)pools[e];
+    if(codec) {
+        pools[e] = codec->getNext();
+        --pooled[e];
+    }
+    pool_lock.unlock();
+    return codec;
+}
+
 void AudioCodec::release(AudioCodec *codec)
 {
-    if(!codec->name)
+    unsigned e;
+
+    if(codec->name)
+        return;
+
+    e = (unsigned)codec->info.encoding;
+    if(e >= CODEC_INDEX || !codec->reset()) {
+        delete codec;
+        return;
+    }
+
+    pool_lock.lock();
+    if(pooled[e] < CODEC_POOL) {
+        codec->enlist(&pools[e]);
+        ++pooled[e];
+        codec = NULL;
+    }
+    pool_lock.unlock();
+
+    if(codec)
         delete codec;
 }
 
+bool AudioCodec::reset(void)
+{
+    return false;
+}
+
 AudioCodec *AudioCodec::begin(void)
 {
-    return (AudioCodec *)first;
+    return (AudioCodec *)CODEC_FIRST;
 }
 
 AudioCodec *AudioCodec::get(Encoding e, const char *format)
 {
-    linked_pointer<AudioCodec> codec = first;
+    AudioCodec *found = NULL;
+    LinkedObject *head;
 
-    while(is(codec)) {
-        if(e == codec->encoding)
-            break;
-        codec.next();
+    if((unsigned)e < CODEC_INDEX)
+        found = CODEC_LOOKUP(e);
+
+    if(!found) {
+        head = CODEC_FIRST;
+        linked_pointer<AudioCodec> codec = head;
+
+        while(is(codec)) {
+            if(e == codec->encoding)
+                break;
+            codec.next();
+        }
+
+        found = *codec;
+        if(found && (unsigned)e < CODEC_INDEX) {
+            CODEC_PUBLISH(e, found);
+            // a codec registered during the walk may be newer than found
+            if(CODEC_FIRST != head)
+                CODEC_PUBLISH(e, (AudioCodec *)NULL);
+        }
     }
 
-    if(is(codec) && format)
-        return codec->getByFormat(format);
+    if(found && format)
+        return found->getByFormat(format);
 
-    return *codec;
+    return found;
 }
 
 AudioCodec *AudioCodec::get(Info &info)
 {
-    linked_pointer<AudioCodec> codec = first;
-
-    while(is(codec)) {
-        if(info.encoding == codec->encoding)
-            break;
-        codec.next();
-    }
+    AudioCodec *codec = get(info.encoding);
 
-    if(is(codec))
+    if(codec)
         return codec->getByInfo(info);
 
-    return *codec;
+    return NULL;
 }
 
 bool AudioCodec::is_silent(Level hint, void *data, unsigned samples)
@@ -124,46 +213,68 @@ bool AudioCodec::is_silent(Level hint, void *data, unsigned samples)
     return true;
 }
 
-Audio::Level AudioCodec::impulse(void *data, unsigned samples)
+// level metering decodes a frame aligned block at a time into scratch
+// on the stack, so metering every frame for silence never allocates.
+
+#define CODEC_BLOCK 960
+
+unsigned AudioCodec::getLevels(levels_t& levels, void *data, unsigned samples)
 {
+    Sample scratch[CODEC_BLOCK];
+    Encoded src = (Encoded)data;
     unsigned long sum = 0;
-    Linear ldata = new Sample[samples];
-    Linear lptr = ldata;
-    long count = decode(ldata, data, samples);
+    double squares = 0.;
+    unsigned unit = info.framecount ? info.framecount : 1;
+    unsigned block = (CODEC_BLOCK / unit) * unit;
+    unsigned count = 0, done, pos;
+    int value, max = 0;
+
+    memset(&levels, 0, sizeof(levels));
+    if(!samples)
+        return 0;
 
-    samples = count;
-    while(samples--) {
-        if(*ldata < 0)
-            sum -= *(ldata++);
-        else
-            sum += *(ldata++);
+    while(block && count < samples) {
+        if(block > samples - count)
+            block = samples - count;
+
+        done = decode(scratch, src, block);
+        for(pos = 0; pos < done; ++pos) {
+            value = abs(scratch[pos]);
+            sum += value;
+            squares += (double)(value * value);
+            if(value > max)
+                max = value;
+        }
+
+        count += done;
+        if(done < block)
+            break;
+        src += (block / unit) * info.framesize;
     }
 
-    delete[] lptr;
-    if(count)
-        return (Level)(sum / count);
-    else
+    if(!count)
         return 0;
+
+    levels.peak = (Level)((max > 32767) ? 32767 : max);
+    levels.mean = (Level)(sum / count);
+    levels.rms = (Level)sqrt(squares / count);
+    return count;
 }
 
-Audio::Level AudioCodec::peak(void *data, unsigned samples)
+Audio::Level AudioCodec::impulse(void *data, unsigned samples)
 {
-    Level max = 0, value;
-    Linear ldata = new Sample[samples];
-    Linear lptr = ldata;
-    long count = decode(ldata, data, samples);
+    levels_t levels;
 
-    samples = count;
-    while(samples--) {
-        value = *(ldata++);
-        if(value < 0)
-            value = -value;
-        if(value > max)
-            max = value;
-    }
+    getLevels(levels, data, samples);
+    return levels.mean;
+}
 
-    delete[] lptr;
-    return max;
+Audio::Level AudioCodec::peak(void *data, unsigned samples)
+{
+    levels_t levels;
+
+    getLevels(levels, data, samples);
+    return levels.peak;
 }
 
 unsigned AudioCodec::getEstimated(void)
@@ -176,23 +287,963 @@ unsigned AudioCodec::getRequired(void)
     return info.framecount;
 }
 
-unsigned AudioCodec::encodeBuffered(Linear buffer, Encoded source, unsigned samples)
-{
-    return encode(buffer, source, samples);
-}
+unsigned AudioCodec::encodeBuffered(Linear buffer, Encoded source, unsigned samples)
+{
+    return encode(buffer, source, samples);
+}
+
+unsigned AudioCodec::decodeBuffered(Linear buffer, Encoded source, unsigned bytes)
+{
+    return decode(buffer, source, toSamples(info, bytes));
+}
+
+unsigned AudioCodec::getPacket(Encoded packet, Encoded data, unsigned bytes)
+{
+    if(bytes != info.framesize)
+        return 0;
+
+    memcpy(packet, data, bytes);
+    return bytes;
+}
+
+// fused transcoding: each block is decoded into a scratch buffer on the
+// stack that stays in L1, and encoded again before the next is decoded,
+// so the caller never needs a linear buffer the size of the payload.
+// Blocks are a whole number of frames of both codecs.
+
+static unsigned transcode_unit(unsigned from, unsigned to)
+{
+    unsigned a = from, b = to, rem;
+
+    while(b) {
+        rem = a % b;
+        a = b;
+        b = rem;
+    }
+    return (from / a) * to;
+}
+
+unsigned AudioCodec::transcode(AudioCodec *to, Encoded dest, Encoded source, unsigned samples)
+{
+    Sample scratch[CODEC_BLOCK];
+    unsigned unit, block, count = 0;
+
+    if(!to || !info.framecount || !to->info.framecount)
+        return 0;
+
+    if(AudioTranscoder::is_direct(info.encoding, to->info.encoding)) {
+        AudioTranscoder direct(info.encoding, to->info.encoding);
+        return direct.process(dest, source, samples);
+    }
+
+    unit = transcode_unit(info.framecount, to->info.framecount);
+    if(unit > CODEC_BLOCK)
+        return 0;
+
+    block = (CODEC_BLOCK / unit) * unit;
+    samples -= samples % unit;
+    while(count < samples) {
+        if(block > samples - count)
+            block = samples - count;
+
+        if(decode(scratch, source, block) < block)
+            break;
+        to->encode(scratch, dest, block);
+
+        source += (block / info.framecount) * info.framesize;
+        dest += (block / to->info.framecount) * to->info.framesize;
+        count += block;
+    }
+    return count;
+}
+
+unsigned AudioCodec::transcode(AudioCodec *to, Encoded *dest, Encoded *source, unsigned samples, unsigned frames)
+{
+    unsigned count = 0;
+
+    if(!to || !info.framecount || !to->info.framecount)
+        return 0;
+
+    // each packet is cut to whole units as the single packet call does
+    if(!AudioTranscoder::is_direct(info.encoding, to->info.encoding))
+        samples -= samples % transcode_unit(info.framecount, to->info.framecount);
+
+    if(!samples)
+        return 0;
+
+    while(count < frames) {
+        if(transcode(to, dest[count], source[count], samples) < samples)
+            break;
+        ++count;
+    }
+    return count;
+}
+
+// declared costs, in cycles per sample at roughly 3 GHz, as measured for
+// the built-in codecs or estimated for the library backed ones.  The list
+// is indexed by encoding at load time.  A codec that knows better may
+// override getCost().
+
+#define DIRECT_CYCLES   1
+#define CHANNEL_CYCLES  1
+#define RESAMPLE_CYCLES 20
+#define DEFAULT_CYCLES  1000
+
+static const struct {
+    Audio::Encoding encoding;
+    unsigned encode, decode;
+}   codec_costs[] = {
+    {Audio::mulawAudio, 3, 2},
+    {Audio::alawAudio, 3, 2},
+    {Audio::g721ADPCM, 400, 350},
+    {Audio::g723_2bit, 400, 350},
+    {Audio::g723_3bit, 450, 380},
+    {Audio::g723_5bit, 400, 350},
+    {Audio::okiADPCM, 15, 10},
+    {Audio::voxADPCM, 15, 10},
+    {Audio::gsmVoice, 1500, 800},
+    {Audio::speexVoice, 4000, 1500},
+    {Audio::speexAudio, 8000, 3000},
+};
+
+static unsigned cost_index[CODEC_INDEX][2];
+
+static class __LOCAL costselect
+{
+public:
+    costselect();
+} cost_select;
+
+costselect::costselect()
+{
+    unsigned pos, e;
+
+    for(e = 0; e < CODEC_INDEX; ++e)
+        cost_index[e][0] = cost_index[e][1] = DEFAULT_CYCLES;
+
+    for(pos = 0; pos < sizeof(codec_costs) / sizeof(codec_costs[0]); ++pos) {
+        e = (unsigned)codec_costs[pos].encoding;
+        cost_index[e][0] = codec_costs[pos].decode;
+        cost_index[e][1] = codec_costs[pos].encode;
+    }
+}
+
+unsigned AudioCodec::getCost(bool encoder)
+{
+    if((unsigned)info.encoding >= CODEC_INDEX)
+        return DEFAULT_CYCLES;
+
+    return cost_index[info.encoding][encoder ? 1 : 0];
+}
+
+unsigned AudioCodec::getScratch(void)
+{
+    return info.framecount * sizeof(Sample);
+}
+
+// planned chains are cached per source encoding and never freed, so a
+// plan pointer stays valid for the life of the process.
+
+class __LOCAL planned : public LinkedObject
+{
+public:
+    AudioCodec::plan_t plan;
+    unsigned long rate;     // rate as requested, 0 for the codec default
+
+    inline planned(LinkedObject **root) : LinkedObject(root) {}
+};
+
+static LinkedObject *plans[CODEC_INDEX];
+static Mutex plan_lock;
+
+// any pcm or cd audio encoding is a linear endpoint; Audio::is_linear()
+// only answers for 16 bit samples.
+
+static bool plan_linear(Audio::Encoding encoding)
+{
+    switch(encoding) {
+    case Audio::pcm8Mono:
+    case Audio::pcm8Stereo:
+    case Audio::pcm16Mono:
+    case Audio::pcm16Stereo:
+    case Audio::pcm32Mono:
+    case Audio::pcm32Stereo:
+    case Audio::cdaMono:
+    case Audio::cdaStereo:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// an endpoint that can carry the requested rate runs at it.  A fixed
+// rate codec always runs at its own rate, and the plan resamples to
+// reach it.  0 is returned for linear endpoints with no rate requested,
+// which then take the rate of the other side.
+
+static unsigned long plan_rate(Audio::Encoding encoding, AudioCodec *codec, unsigned long rate)
+{
+    unsigned long carried = (unsigned long)Audio::getRate(encoding, (Audio::Rate)rate);
+
+    if(rate && carried == rate)
+        return rate;
+
+    if(codec && codec->getInfo().rate)
+        return codec->getInfo().rate;
+
+    return carried;
+}
+
+static bool plan_chain(AudioCodec::plan_t *plan)
+{
+    AudioCodec *decoder = NULL, *encoder = NULL;
+    unsigned long from_rate, to_rate;
+    unsigned scratch = 0;
+    bool from_stereo = Audio::is_stereo(plan->from);
+    bool to_stereo = Audio::is_stereo(plan->to);
+
+    plan->steps = 0;
+    plan->cycles = 0;
+    plan->scratch = 0;
+
+    if(!plan_linear(plan->from)) {
+        decoder = AudioCodec::get(plan->from);
+        if(!decoder)
+            return false;
+    }
+
+    if(!plan_linear(plan->to)) {
+        encoder = AudioCodec::get(plan->to);
+        if(!encoder)
+            return false;
+    }
+
+    from_rate = plan_rate(plan->from, decoder, plan->rate);
+    to_rate = plan_rate(plan->to, encoder, plan->rate);
+    if(!to_rate)
+        to_rate = from_rate;
+    if(!from_rate)
+        from_rate = to_rate;
+    plan->rate = to_rate;
+
+    if(plan->from == plan->to && from_rate == to_rate)
+        return true;
+
+    // a byte domain map is always cheaper than going through linear
+    if(from_rate == to_rate && AudioTranscoder::is_direct(plan->from, plan->to)) {
+        plan->step[plan->steps++] = AudioCodec::stepDirect;
+        plan->cycles = DIRECT_CYCLES;
+        return true;
+    }
+
+    if(decoder) {
+        plan->step[plan->steps++] = AudioCodec::stepDecode;
+        plan->cycles += decoder->getCost(false);
+        scratch = decoder->getScratch();
+    }
+
+    // channels are folded down before a resample and spread after one,
+    // so the resampler always runs on the narrower side.
+    if(from_stereo && !to_stereo) {
+        plan->step[plan->steps++] = AudioCodec::stepChannels;
+        plan->cycles += CHANNEL_CYCLES;
+    }
+
+    if(from_rate != to_rate) {
+        plan->step[plan->steps++] = AudioCodec::stepResample;
+        plan->cycles += RESAMPLE_CYCLES;
+    }
+
+    if(!from_stereo && to_stereo) {
+        plan->step[plan->steps++] = AudioCodec::stepChannels;
+        plan->cycles += CHANNEL_CYCLES;
+    }
+
+    if(encoder) {
+        plan->step[plan->steps++] = AudioCodec::stepEncode;
+        plan->cycles += encoder->getCost(true);
+        if(encoder->getScratch() > scratch)
+            scratch = encoder->getScratch();
+    }
+
+    // a resampler needs room for both sides of the rate change, and a
+    // channel step for the stereo side
+    if(from_rate != to_rate)
+        scratch += (unsigned)((scratch * to_rate) / from_rate);
+    if(from_stereo != to_stereo)
+        scratch *= 2;
+
+    plan->scratch = scratch;
+    return true;
+}
+
+static planned *plan_find(Audio::Encoding from, Audio::Encoding to, unsigned long rate)
+{
+    linked_pointer<planned> cp = plans[from];
+
+    while(is(cp)) {
+        if(cp->plan.to == to && cp->rate == rate)
+            break;
+        cp.next();
+    }
+    return *cp;
+}
+
+const AudioCodec::plan_t *AudioCodec::getPlan(Encoding from, Encoding to, unsigned long rate)
+{
+    planned *found;
+    plan_t plan;
+
+    if((unsigned)from >= CODEC_INDEX)
+        return NULL;
+
+    plan_lock.lock();
+    found = plan_find(from, to, rate);
+    plan_lock.unlock();
+
+    if(found)
+        return &found->plan;
+
+    memset(&plan, 0, sizeof(plan));
+    plan.from = from;
+    plan.to = to;
+    plan.rate = rate;
+    if(!plan_chain(&plan))
+        return NULL;
+
+    plan_lock.lock();
+    found = plan_find(from, to, rate);
+    if(!found) {
+        found = new planned(&plans[from]);
+        found->plan = plan;
+        found->rate = rate;
+    }
+    plan_lock.unlock();
+    return &found->plan;
+}
+
+// g711 batch kernels.  Each kernel converts the largest whole number of
+// vector blocks it can and returns how many samples it handled, and the
+// codec finishes any remainder with its own scalar loop.  The scalar loops
+// remain the reference; the kernels must match them bit for bit.
+
+#if defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+#define G711_SSE2
+#include <emmintrin.h>
+#if __GNUC__ >= 5 || defined(__clang__)
+#define G711_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define G711_NEON
+#include <arm_neon.h>
+#endif
+
+#define ULAW_CLIP   32635
+#define AMI_MASK    0x55
+
+typedef unsigned (*g711encoder_t)(Audio::Linear buffer, unsigned char *dest, unsigned samples);
+typedef unsigned (*g711decoder_t)(Audio::Linear buffer, const unsigned char *src, unsigned samples);
+
+typedef struct {
+    g711encoder_t ulaw_encode, alaw_encode;
+    g711decoder_t ulaw_decode, alaw_decode;
+}   g711kernels_t;
+
+// each engine is an immutable kernel set; setEngine() swaps a single
+// pointer, published with a release store and read once per call with
+// an acquire load, so a coder never sees half of one engine's kernels.
+
+static g711kernels_t g711_scalar = {NULL, NULL, NULL, NULL};
+static g711kernels_t g711_vector = {NULL, NULL, NULL, NULL};
+static g711kernels_t g711_table = {NULL, NULL, NULL, NULL};
+static g711kernels_t g711_auto = {NULL, NULL, NULL, NULL};
+static const g711kernels_t *g711_kernels = &g711_scalar;
+
+#ifdef  __GNUC__
+#define G711_KERNELS            __atomic_load_n(&g711_kernels, __ATOMIC_ACQUIRE)
+#define G711_PUBLISH(k)         __atomic_store_n(&g711_kernels, k, __ATOMIC_RELEASE)
+#else
+#define G711_KERNELS            g711_kernels
+#define G711_PUBLISH(k)         g711_kernels = k
+#endif
+
+// scalar reference coders
+
+static void ulaw_encode_scalar(Audio::Linear buffer, unsigned char *d, unsigned lsamples)
+{
+    static int ulaw[256] = {
+        0,0,1,1,2,2,2,2,3,3,3,3,3,3,3,3,
+        4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+        5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,
+        5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,
+        6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,
+        6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,
+        6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,
+        6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,
+        7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,
+        7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,
+        7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,
+        7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,
+        7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,
+        7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,
+        7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,
+        7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7};
+
+    int sample, sign, exponent, mantissa, retval;
+
+    while(lsamples--) {
+        sample = *(buffer++);
+                sign = (sample >> 8) & 0x80;
+            if(sign != 0) sample = -sample;
+            if(sample > ULAW_CLIP) sample = ULAW_CLIP;
+            sample += 0x84;
+            exponent = ulaw[(sample >> 7) & 0xff];
+            mantissa = (sample >> (exponent + 3)) & 0x0f;
+            retval = ~(sign | (exponent << 4) | mantissa);
+            if(!retval)
+            retval = 0x02;
+        *(d++) = (unsigned char)retval;
+    }
+}
+
+static void alaw_encode_scalar(Audio::Linear buffer, unsigned char *d, unsigned lsamples)
+{
+    int mask, seg, pcm_val;
+
+    static int seg_end[] = {
+        0xFF, 0x1FF, 0x3FF, 0x7FF, 0xFFF, 0x1FFF, 0x3FFF, 0x7FFF};
+
+    while(lsamples--) {
+        pcm_val = *(buffer++);
+        if(pcm_val >= 0)
+            mask = AMI_MASK | 0x80;
+        else {
+            mask = AMI_MASK;
+            pcm_val = -pcm_val;
+        }
+        for(seg = 0; seg < 8; seg++)
+        {
+            if(pcm_val <= seg_end[seg])
+                break;
+        }
+        if(seg > 7) {   // -32768 is out of range, clip to largest magnitude
+            *(d++) = 0x7f ^ mask;
+            continue;
+        }
+        *(d++) = ((seg << 4) | ((pcm_val >> ((seg)  ?  (seg + 3)  :  4)) & 0x0F)) ^ mask;
+    }
+}
+
+// table engine: every 16 bit sample indexes its code directly.  The
+// tables are filled from the scalar coders so they can never drift from
+// the reference, but only the first time the table engine is bound, as
+// processes that keep the vector kernels never touch them.
+
+static unsigned char ulaw_table[65536], alaw_table[65536];
+static bool g711_tabled = false;
+static Mutex g711_lock;
+
+static void g711_tables(void)
+{
+    Audio::Sample sample[256];
+    unsigned index, pos;
+
+    g711_lock.lock();
+    if(!g711_tabled) {
+        for(index = 0; index < 65536; index += 256) {
+            for(pos = 0; pos < 256; ++pos)
+                sample[pos] = (Audio::Sample)(index + pos);
+            ulaw_encode_scalar(sample, &ulaw_table[index], 256);
+            alaw_encode_scalar(sample, &alaw_table[index], 256);
+        }
+        g711_tabled = true;
+    }
+    g711_lock.unlock();
+}
+
+static unsigned ulaw_encode_table(Audio::Linear buffer, unsigned char *dest, unsigned samples)
+{
+    unsigned pos;
+
+    for(pos = 0; pos < samples; ++pos)
+        dest[pos] = ulaw_table[(unsigned short)buffer[pos]];
+    return samples;
+}
+
+static unsigned alaw_encode_table(Audio::Linear buffer, unsigned char *dest, unsigned samples)
+{
+    unsigned pos;
+
+    for(pos = 0; pos < samples; ++pos)
+        dest[pos] = alaw_table[(unsigned short)buffer[pos]];
+    return samples;
+}
+
+#ifdef  G711_SSE2
+
+static inline __m128i g711_select_sse2(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// shift each lane by the low three bits of its own count; sse2 has no
+// per-lane shift, so the count is applied one bit at a time.
+
+static inline __m128i g711_shl_sse2(__m128i x, __m128i n)
+{
+    const __m128i b1 = _mm_set1_epi16(1), b2 = _mm_set1_epi16(2), b4 = _mm_set1_epi16(4);
+
+    x = g711_select_sse2(_mm_cmpeq_epi16(_mm_and_si128(n, b1), b1), _mm_slli_epi16(x, 1), x);
+    x = g711_select_sse2(_mm_cmpeq_epi16(_mm_and_si128(n, b2), b2), _mm_slli_epi16(x, 2), x);
+    return g711_select_sse2(_mm_cmpeq_epi16(_mm_and_si128(n, b4), b4), _mm_slli_epi16(x, 4), x);
+}
+
+static inline __m128i g711_shr_sse2(__m128i x, __m128i n)
+{
+    const __m128i b1 = _mm_set1_epi16(1), b2 = _mm_set1_epi16(2), b4 = _mm_set1_epi16(4);
+
+    x = g711_select_sse2(_mm_cmpeq_epi16(_mm_and_si128(n, b1), b1), _mm_srli_epi16(x, 1), x);
+    x = g711_select_sse2(_mm_cmpeq_epi16(_mm_and_si128(n, b2), b2), _mm_srli_epi16(x, 2), x);
+    return g711_select_sse2(_mm_cmpeq_epi16(_mm_and_si128(n, b4), b4), _mm_srli_epi16(x, 4), x);
+}
+
+static unsigned ulaw_encode_sse2(Audio::Linear buffer, unsigned char *dest, unsigned samples)
+{
+    const __m128i clip = _mm_set1_epi16(ULAW_CLIP);
+    const __m128i bias = _mm_set1_epi16(0x84);
+    const __m128i low = _mm_set1_epi16(0x0f);
+    const __m128i sign = _mm_set1_epi16(0x80);
+    const __m128i bytes = _mm_set1_epi16(0xff);
+    unsigned count = samples & ~7u;
+    unsigned pos, seg;
+
+    for(pos = 0; pos < count; pos += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(buffer + pos));
+        __m128i s = _mm_srai_epi16(x, 15);
+        __m128i mag = _mm_min_epi16(_mm_subs_epi16(_mm_xor_si128(x, s), s), clip);
+        __m128i exp = _mm_setzero_si128();
+
+        mag = _mm_add_epi16(mag, bias);
+        for(seg = 0; seg < 7; ++seg)
+            exp = _mm_sub_epi16(exp, _mm_cmpgt_epi16(mag, _mm_set1_epi16((0x100 << seg) - 1)));
+
+        __m128i mant = _mm_and_si128(g711_shr_sse2(_mm_srli_epi16(mag, 3), exp), low);
+        __m128i code = _mm_or_si128(_mm_or_si128(_mm_and_si128(s, sign), _mm_slli_epi16(exp, 4)), mant);
+        code = _mm_andnot_si128(code, bytes);
+        _mm_storel_epi64((__m128i *)(dest + pos), _mm_packus_epi16(code, code));
+    }
+    return count;
+}
+
+static unsigned ulaw_decode_sse2(Audio::Linear buffer, const unsigned char *src, unsigned samples)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(0x84);
+    const __m128i low = _mm_set1_epi16(0x0f);
+    const __m128i bytes = _mm_set1_epi16(0xff);
+    unsigned count = samples & ~7u;
+    unsigned pos;
+
+    for(pos = 0; pos < count; pos += 8) {
+        __m128i u = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(src + pos)), zero);
+        u = _mm_xor_si128(u, bytes);
+
+        __m128i t = _mm_add_epi16(_mm_slli_epi16(_mm_and_si128(u, low), 3), bias);
+        __m128i neg = _mm_srai_epi16(_mm_slli_epi16(u, 8), 15);
+        t = _mm_sub_epi16(g711_shl_sse2(t, _mm_srli_epi16(u, 4)), bias);
+        t = _mm_sub_epi16(_mm_xor_si128(t, neg), neg);
+        _mm_storeu_si128((__m128i *)(buffer + pos), t);
+    }
+    return count;
+}
+
+static unsigned alaw_encode_sse2(Audio::Linear buffer, unsigned char *dest, unsigned samples)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i low = _mm_set1_epi16(0x0f);
+    const __m128i sign = _mm_set1_epi16(0x80);
+    const __m128i ami = _mm_set1_epi16(AMI_MASK | 0x80);
+    unsigned count = samples & ~7u;
+    unsigned pos, seg;
+
+    for(pos = 0; pos < count; pos += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(buffer + pos));
+        __m128i s = _mm_srai_epi16(x, 15);
+        __m128i mask = _mm_xor_si128(ami, _mm_and_si128(s, sign));
+        __m128i mag = _mm_subs_epi16(_mm_xor_si128(x, s), s);
+        __m128i segs = zero;
+
+        for(seg = 0; seg < 7; ++seg)
+            segs = _mm_sub_epi16(segs, _mm_cmpgt_epi16(mag, _mm_set1_epi16((0x100 << seg) - 1)));
+
+        // segment 0 shares the mantissa shift of segment 1
+        __m128i shift = _mm_sub_epi16(segs, _mm_andnot_si128(_mm_cmpeq_epi16(segs, zero), one));
+        __m128i mant = _mm_and_si128(g711_shr_sse2(_mm_srli_epi16(mag, 4), shift), low);
+        __m128i code = _mm_xor_si128(_mm_or_si128(_mm_slli_epi16(segs, 4), mant), mask);
+        _mm_storel_epi64((__m128i *)(dest + pos), _mm_packus_epi16(code, code));
+    }
+    return count;
+}
+
+static unsigned alaw_decode_sse2(Audio::Linear buffer, const unsigned char *src, unsigned samples)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i low = _mm_set1_epi16(0x0f);
+    const __m128i sign = _mm_set1_epi16(0x80);
+    const __m128i ami = _mm_set1_epi16(AMI_MASK);
+    unsigned count = samples & ~7u;
+    unsigned pos;
+
+    for(pos = 0; pos < count; pos += 8) {
+        __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(src + pos)), zero);
+        a = _mm_xor_si128(a, ami);
+
+        __m128i seg = _mm_and_si128(_mm_srli_epi16(a, 4), _mm_set1_epi16(7));
+        __m128i z = _mm_cmpeq_epi16(seg, zero);
+        __m128i t = _mm_slli_epi16(_mm_and_si128(a, low), 4);
+        __m128i neg = _mm_cmpeq_epi16(_mm_and_si128(a, sign), zero);
+
+        t = _mm_add_epi16(t, g711_select_sse2(z, _mm_set1_epi16(8), _mm_set1_epi16(0x108)));
+        t = g711_shl_sse2(t, _mm_sub_epi16(seg, _mm_andnot_si128(z, one)));
+        t = _mm_sub_epi16(_mm_xor_si128(t, neg), neg);
+        _mm_storeu_si128((__m128i *)(buffer + pos), t);
+    }
+    return count;
+}
+
+#endif
+
+#ifdef  G711_AVX2
+
+#define G711_AVX2_TARGET __attribute__((target("avx2")))
+
+static inline G711_AVX2_TARGET __m256i g711_select_avx2(__m256i mask, __m256i a, __m256i b)
+{
+    return _mm256_blendv_epi8(b, a, mask);
+}
+
+// avx2 only has per-lane shifts for 32 bit lanes, so 16 bit lanes are
+// shifted one count bit at a time as in the sse2 kernels.
+
+static inline G711_AVX2_TARGET __m256i g711_shl_avx2(__m256i x, __m256i n)
+{
+    const __m256i b1 = _mm256_set1_epi16(1), b2 = _mm256_set1_epi16(2), b4 = _mm256_set1_epi16(4);
+
+    x = g711_select_avx2(_mm256_cmpeq_epi16(_mm256_and_si256(n, b1), b1), _mm256_slli_epi16(x, 1), x);
+    x = g711_select_avx2(_mm256_cmpeq_epi16(_mm256_and_si256(n, b2), b2), _mm256_slli_epi16(x, 2), x);
+    return g711_select_avx2(_mm256_cmpeq_epi16(_mm256_and_si256(n, b4), b4), _mm256_slli_epi16(x, 4), x);
+}
+
+static inline G711_AVX2_TARGET __m256i g711_shr_avx2(__m256i x, __m256i n)
+{
+    const __m256i b1 = _mm256_set1_epi16(1), b2 = _mm256_set1_epi16(2), b4 = _mm256_set1_epi16(4);
+
+    x = g711_select_avx2(_mm256_cmpeq_epi16(_mm256_and_si256(n, b1), b1), _mm256_srli_epi16(x, 1), x);
+    x = g711_select_avx2(_mm256_cmpeq_epi16(_mm256_and_si256(n, b2), b2), _mm256_srli_epi16(x, 2), x);
+    return g711_select_avx2(_mm256_cmpeq_epi16(_mm256_and_si256(n, b4), b4), _mm256_srli_epi16(x, 4), x);
+}
+
+// pack sixteen 16 bit codes to bytes; packus works within 128 bit halves
+static inline G711_AVX2_TARGET void g711_store_avx2(unsigned char *dest, __m256i code)
+{
+    code = _mm256_permute4x64_epi64(_mm256_packus_epi16(code, code), 0xd8);
+    _mm_storeu_si128((__m128i *)dest, _mm256_castsi256_si128(code));
+}
+
+static G711_AVX2_TARGET unsigned ulaw_encode_avx2(Audio::Linear buffer, unsigned char *dest, unsigned samples)
+{
+    const __m256i clip = _mm256_set1_epi16(ULAW_CLIP);
+    const __m256i bias = _mm256_set1_epi16(0x84);
+    const __m256i low = _mm256_set1_epi16(0x0f);
+    const __m256i sign = _mm256_set1_epi16(0x80);
+    const __m256i bytes = _mm256_set1_epi16(0xff);
+    unsigned count = samples & ~15u;
+    unsigned pos, seg;
+
+    for(pos = 0; pos < count; pos += 16) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(buffer + pos));
+        __m256i s = _mm256_srai_epi16(x, 15);
+        __m256i mag = _mm256_min_epu16(_mm256_abs_epi16(x), clip);
+        __m256i exp = _mm256_setzero_si256();
+
+        mag = _mm256_add_epi16(mag, bias);
+        for(seg = 0; seg < 7; ++seg)
+            exp = _mm256_sub_epi16(exp, _mm256_cmpgt_epi16(mag, _mm256_set1_epi16((0x100 << seg) - 1)));
+
+        __m256i mant = _mm256_and_si256(g711_shr_avx2(_mm256_srli_epi16(mag, 3), exp), low);
+        __m256i code = _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(s, sign), _mm256_slli_epi16(exp, 4)), mant);
+        g711_store_avx2(dest + pos, _mm256_andnot_si256(code, bytes));
+    }
+    return count;
+}
+
+static G711_AVX2_TARGET unsigned ulaw_decode_avx2(Audio::Linear buffer, const unsigned char *src, unsigned samples)
+{
+    const __m256i bias = _mm256_set1_epi16(0x84);
+    const __m256i low = _mm256_set1_epi16(0x0f);
+    const __m256i bytes = _mm256_set1_epi16(0xff);
+    unsigned count = samples & ~15u;
+    unsigned pos;
+
+    for(pos = 0; pos < count; pos += 16) {
+        __m256i u = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(src + pos)));
+        u = _mm256_xor_si256(u, bytes);
+
+        __m256i t = _mm256_add_epi16(_mm256_slli_epi16(_mm256_and_si256(u, low), 3), bias);
+        __m256i neg = _mm256_srai_epi16(_mm256_slli_epi16(u, 8), 15);
+        t = _mm256_sub_epi16(g711_shl_avx2(t, _mm256_srli_epi16(u, 4)), bias);
+        t = _mm256_sub_epi16(_mm256_xor_si256(t, neg), neg);
+        _mm256_storeu_si256((__m256i *)(buffer + pos), t);
+    }
+    return count;
+}
+
+static G711_AVX2_TARGET unsigned alaw_encode_avx2(Audio::Linear buffer, unsigned char *dest, unsigned samples)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi16(1);
+    const __m256i low = _mm256_set1_epi16(0x0f);
+    const __m256i sign = _mm256_set1_epi16(0x80);
+    const __m256i ami = _mm256_set1_epi16(AMI_MASK | 0x80);
+    const __m256i top = _mm256_set1_epi16(0x7fff);
+    unsigned count = samples & ~15u;
+    unsigned pos, seg;
+
+    for(pos = 0; pos < count; pos += 16) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(buffer + pos));
+        __m256i s = _mm256_srai_epi16(x, 15);
+        __m256i mask = _mm256_xor_si256(ami, _mm256_and_si256(s, sign));
+        __m256i mag = _mm256_min_epu16(_mm256_abs_epi16(x), top);
+        __m256i segs = zero;
+
+        for(seg = 0; seg < 7; ++seg)
+            segs = _mm256_sub_epi16(segs, _mm256_cmpgt_epi16(mag, _mm256_set1_epi16((0x100 << seg) - 1)));
+
+        __m256i shift = _mm256_sub_epi16(segs, _mm256_andnot_si256(_mm256_cmpeq_epi16(segs, zero), one));
+        __m256i mant = _mm256_and_si256(g711_shr_avx2(_mm256_srli_epi16(mag, 4), shift), low);
+        g711_store_avx2(dest + pos, _mm256_xor_si256(_mm256_or_si256(_mm256_slli_epi16(segs, 4), mant), mask));
+    }
+    return count;
+}
+
+static G711_AVX2_TARGET unsigned alaw_decode_avx2(Audio::Linear buffer, const unsigned char *src, unsigned samples)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi16(1);
+    const __m256i low = _mm256_set1_epi16(0x0f);
+    const __m256i sign = _mm256_set1_epi16(0x80);
+    const __m256i ami = _mm256_set1_epi16(AMI_MASK);
+    unsigned count = samples & ~15u;
+    unsigned pos;
+
+    for(pos = 0; pos < count; pos += 16) {
+        __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(src + pos)));
+        a = _mm256_xor_si256(a, ami);
+
+        __m256i seg = _mm256_and_si256(_mm256_srli_epi16(a, 4), _mm256_set1_epi16(7));
+        __m256i z = _mm256_cmpeq_epi16(seg, zero);
+        __m256i t = _mm256_slli_epi16(_mm256_and_si256(a, low), 4);
+        __m256i neg = _mm256_cmpeq_epi16(_mm256_and_si256(a, sign), zero);
+
+        t = _mm256_add_epi16(t, g711_select_avx2(z, _mm256_set1_epi16(8), _mm256_set1_epi16(0x108)));
+        t = g711_shl_avx2(t, _mm256_sub_epi16(seg, _mm256_andnot_si256(z, one)));
+        t = _mm256_sub_epi16(_mm256_xor_si256(t, neg), neg);
+        _mm256_storeu_si256((__m256i *)(buffer + pos), t);
+    }
+    return count;
+}
+
+#endif
+
+#ifdef  G711_NEON
+
+static unsigned ulaw_encode_neon(Audio::Linear buffer, unsigned char *dest, unsigned samples)
+{
+    const int16x8_t clip = vdupq_n_s16(ULAW_CLIP);
+    const int16x8_t bias = vdupq_n_s16(0x84);
+    const int16x8_t low = vdupq_n_s16(0x0f);
+    const int16x8_t sign = vdupq_n_s16(0x80);
+    const int16x8_t bytes = vdupq_n_s16(0xff);
+    unsigned count = samples & ~7u;
+    unsigned pos, seg;
+
+    for(pos = 0; pos < count; pos += 8) {
+        int16x8_t x = vld1q_s16(buffer + pos);
+        int16x8_t s = vshrq_n_s16(x, 15);
+        int16x8_t mag = vaddq_s16(vminq_s16(vqabsq_s16(x), clip), bias);
+        int16x8_t exp = vdupq_n_s16(0);
+
+        for(seg = 0; seg < 7; ++seg)
+            exp = vsubq_s16(exp, vreinterpretq_s16_u16(vcgtq_s16(mag, vdupq_n_s16((0x100 << seg) - 1))));
+
+        int16x8_t mant = vandq_s16(vshlq_s16(mag, vnegq_s16(vaddq_s16(exp, vdupq_n_s16(3)))), low);
+        int16x8_t code = vorrq_s16(vorrq_s16(vandq_s16(s, sign), vshlq_n_s16(exp, 4)), mant);
+        code = vbicq_s16(bytes, code);
+        vst1_u8(dest + pos, vmovn_u16(vreinterpretq_u16_s16(code)));
+    }
+    return count;
+}
+
+static unsigned ulaw_decode_neon(Audio::Linear buffer, const unsigned char *src, unsigned samples)
+{
+    const int16x8_t bias = vdupq_n_s16(0x84);
+    const int16x8_t low = vdupq_n_s16(0x0f);
+    unsigned count = samples & ~7u;
+    unsigned pos;
+
+    for(pos = 0; pos < count; pos += 8) {
+        int16x8_t u = vreinterpretq_s16_u16(vmovl_u8(vmvn_u8(vld1_u8(src + pos))));
+        int16x8_t t = vaddq_s16(vshlq_n_s16(vandq_s16(u, low), 3), bias);
+        int16x8_t neg = vreinterpretq_s16_u16(vtstq_s16(u, vdupq_n_s16(0x80)));
+
+        t = vsubq_s16(vshlq_s16(t, vandq_s16(vshrq_n_s16(u, 4), vdupq_n_s16(7))), bias);
+        vst1q_s16(buffer + pos, vsubq_s16(veorq_s16(t, neg), neg));
+    }
+    return count;
+}
+
+static unsigned alaw_encode_neon(Audio::Linear buffer, unsigned char *dest, unsigned samples)
+{
+    const int16x8_t one = vdupq_n_s16(1);
+    const int16x8_t low = vdupq_n_s16(0x0f);
+    const int16x8_t sign = vdupq_n_s16(0x80);
+    const int16x8_t ami = vdupq_n_s16(AMI_MASK | 0x80);
+    unsigned count = samples & ~7u;
+    unsigned pos, seg;
+
+    for(pos = 0; pos < count; pos += 8) {
+        int16x8_t x = vld1q_s16(buffer + pos);
+        int16x8_t s = vshrq_n_s16(x, 15);
+        int16x8_t mask = veorq_s16(ami, vandq_s16(s, sign));
+        int16x8_t mag = vqabsq_s16(x);
+        int16x8_t segs = vdupq_n_s16(0);
+
+        for(seg = 0; seg < 7; ++seg)
+            segs = vsubq_s16(segs, vreinterpretq_s16_u16(vcgtq_s16(mag, vdupq_n_s16((0x100 << seg) - 1))));
+
+        int16x8_t shift = vnegq_s16(vaddq_s16(vmaxq_s16(segs, one), vdupq_n_s16(3)));
+        int16x8_t mant = vandq_s16(vshlq_s16(mag, shift), low);
+        int16x8_t code = veorq_s16(vorrq_s16(vshlq_n_s16(segs, 4), mant), mask);
+        vst1_u8(dest + pos, vmovn_u16(vreinterpretq_u16_s16(code)));
+    }
+    return count;
+}
+
+static unsigned alaw_decode_neon(Audio::Linear buffer, const unsigned char *src, unsigned samples)
+{
+    const int16x8_t zero = vdupq_n_s16(0);
+    const int16x8_t one = vdupq_n_s16(1);
+    unsigned count = samples & ~7u;
+    unsigned pos;
+
+    for(pos = 0; pos < count; pos += 8) {
+        int16x8_t a = vreinterpretq_s16_u16(vmovl_u8(veor_u8(vld1_u8(src + pos), vdup_n_u8(AMI_MASK))));
+        int16x8_t seg = vandq_s16(vshrq_n_s16(a, 4), vdupq_n_s16(7));
+        uint16x8_t z = vceqq_s16(seg, zero);
+        int16x8_t t = vshlq_n_s16(vandq_s16(a, vdupq_n_s16(0x0f)), 4);
+        int16x8_t neg = vreinterpretq_s16_u16(vceqq_s16(vandq_s16(a, vdupq_n_s16(0x80)), zero));
+
+        t = vaddq_s16(t, vbslq_s16(z, vdupq_n_s16(8), vdupq_n_s16(0x108)));
+        t = vshlq_s16(t, vsubq_s16(vmaxq_s16(seg, one), one));
+        vst1q_s16(buffer + pos, vsubq_s16(veorq_s16(t, neg), neg));
+    }
+    return count;
+}
+
+#endif
+
+// kernels are bound once at static init from what the cpu reports
+
+static AudioCodec::Engine g711_engine = AudioCodec::engineAuto;
+
+static class __LOCAL g711select
+{
+public:
+    g711select();
+} g711_select;
+
+g711select::g711select()
+{
+#ifdef  G711_SSE2
+    g711_vector.ulaw_encode = &ulaw_encode_sse2;
+    g711_vector.ulaw_decode = &ulaw_decode_sse2;
+    g711_vector.alaw_encode = &alaw_encode_sse2;
+    g711_vector.alaw_decode = &alaw_decode_sse2;
+#endif
+
+#ifdef  G711_AVX2
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) {
+        g711_vector.ulaw_encode = &ulaw_encode_avx2;
+        g711_vector.ulaw_decode = &ulaw_decode_avx2;
+        g711_vector.alaw_encode = &alaw_encode_avx2;
+        g711_vector.alaw_decode = &alaw_decode_avx2;
+    }
+#endif
+
+#ifdef  G711_NEON
+    g711_vector.ulaw_encode = &ulaw_encode_neon;
+    g711_vector.ulaw_decode = &ulaw_decode_neon;
+    g711_vector.alaw_encode = &alaw_encode_neon;
+    g711_vector.alaw_decode = &alaw_decode_neon;
+#endif
+
+    // decoding is already a single table load per sample
+    g711_table.ulaw_encode = &ulaw_encode_table;
+    g711_table.alaw_encode = &alaw_encode_table;
+
+    g711_auto = g711_vector;
+    if(!g711_auto.ulaw_encode)
+        g711_auto.ulaw_encode = &ulaw_encode_table;
+    if(!g711_auto.alaw_encode)
+        g711_auto.alaw_encode = &alaw_encode_table;
+
+    AudioCodec::setEngine(g711_engine);
+}
+
+void AudioCodec::setEngine(Engine mode)
+{
+    const g711kernels_t *kernels;
+
+    switch(mode) {
+    case engineScalar:
+        kernels = &g711_scalar;
+        break;
+    case engineTable:
+        kernels = &g711_table;
+        break;
+    case engineVector:
+        kernels = &g711_vector;
+        break;
+    default:
+        kernels = &g711_auto;
+        break;
+    }
+
+    // tables are complete before any kernel that reads them is published
+    if(kernels->ulaw_encode == &ulaw_encode_table || kernels->alaw_encode == &alaw_encode_table)
+        g711_tables();
 
-unsigned AudioCodec::decodeBuffered(Linear buffer, Encoded source, unsigned bytes)
-{
-    return decode(buffer, source, toSamples(info, bytes));
+#ifdef  __GNUC__
+    __atomic_store_n(&g711_engine, mode, __ATOMIC_RELAXED);
+#else
+    g711_engine = mode;
+#endif
+    G711_PUBLISH(kernels);
 }
 
-unsigned AudioCodec::getPacket(Encoded packet, Encoded data, unsigned bytes)
+AudioCodec::Engine AudioCodec::getEngine(void)
 {
-    if(bytes != info.framesize)
-        return 0;
-
-    memcpy(packet, data, bytes);
-    return bytes;
+#ifdef  __GNUC__
+    return __atomic_load_n(&g711_engine, __ATOMIC_RELAXED);
+#else
+    return g711_engine;
+#endif
 }
 
 // g711 codecs initialized in static linkage...
@@ -209,6 +1260,7 @@ private:
     unsigned decode(Linear buffer, void *dest, unsigned lsamples) __FINAL;
     Level impulse(void *buffer, unsigned samples) __FINAL;
     Level peak(void *buffer, unsigned samples) __FINAL;
+    unsigned getLevels(levels_t& levels, void *buffer, unsigned samples) __FINAL;
 
 } g711u;
 
@@ -224,6 +1276,7 @@ private:
     unsigned decode(Linear buffer, void *dest, unsigned lsamples) __FINAL;
     Level impulse(void *buffer, unsigned samples) __FINAL;
     Level peak(void *buffer, unsigned samples) __FINAL;
+    unsigned getLevels(levels_t& levels, void *buffer, unsigned samples) __FINAL;
 
 } g711a;
 
@@ -245,7 +1298,8 @@ g711a::g711a() : AudioCodec("g.711", alawAudio)
     info.annotation = (char *)"a-law";
 }
 
-static unsigned ullevels[128] =
+// code magnitude tables, also used by the detectors to gate g.711 input
+__LOCAL unsigned ullevels[128] =
 {
             32124,   31100,   30076,   29052,   28028,
     27004,   25980,   24956,   23932,   22908,   21884,   20860,
@@ -268,86 +1322,70 @@ static unsigned ullevels[128] =
     24,      16,       8,       0
 };
 
-Audio::Level g711u::impulse(void *data, unsigned samples)
+// single pass over the code magnitudes for all three levels
+static unsigned g711_levels(const unsigned *table, AudioCodec::levels_t& levels, void *data, unsigned samples)
 {
-    unsigned long count = samples;
+    unsigned char *dp = (unsigned char *)data;
     unsigned long sum = 0;
+    double squares = 0.;
+    unsigned value, max = 0, count;
 
     if(!samples)
-        samples = count = 160;
+        samples = 160;
 
-    unsigned char *dp = (unsigned char *)data;
+    for(count = 0; count < samples; ++count) {
+        value = table[*(dp++) & 0x7f];
+        sum += value;
+        squares += (double)(value * value);
+        if(value > max)
+            max = value;
+    }
 
-    while(samples--)
-        sum += (ullevels[*(dp++) & 0x7f]);
+    levels.peak = (Audio::Level)((max > 32767) ? 32767 : max);
+    levels.mean = (Audio::Level)(sum / samples);
+    levels.rms = (Audio::Level)sqrt(squares / samples);
+    return samples;
+}
 
-    return (Level)(sum / count);
+unsigned g711u::getLevels(levels_t& levels, void *data, unsigned samples)
+{
+    return g711_levels(ullevels, levels, data, samples);
 }
 
-Audio::Level g711u::peak(void *data, unsigned samples)
+Audio::Level g711u::impulse(void *data, unsigned samples)
 {
-    unsigned long count = samples;
-    Level max = 0, value;
+    levels_t levels;
 
-    if(!samples)
-        samples = count = 160;
+    g711_levels(ullevels, levels, data, samples);
+    return levels.mean;
+}
 
-    unsigned char *dp = (unsigned char *)data;
+Audio::Level g711u::peak(void *data, unsigned samples)
+{
+    levels_t levels;
 
-    while(samples--) {
-        value = ullevels[*(dp++) & 0x7f];
-        if(value > max)
-            max = value;
-    }
-    return max;
+    g711_levels(ullevels, levels, data, samples);
+    return levels.peak;
 }
 
 unsigned g711u::encode(Linear buffer, void *dest, unsigned lsamples)
 {
-    static int ulaw[256] = {
-        0,0,1,1,2,2,2,2,3,3,3,3,3,3,3,3,
-        4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
-        5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,
-        5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,
-        6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,
-        6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,
-        6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,
-        6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,
-        7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,
-        7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,
-        7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,
-        7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,
-        7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,
-        7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,
-        7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,
-        7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7};
-
-    Sample sample;
-    int sign, exponent, mantissa, retval;
     unsigned char *d = (unsigned char *)dest;
-    unsigned count;
+    const g711kernels_t *kernels = G711_KERNELS;
+    unsigned done = 0;
 
-    count = lsamples;
+    if(kernels->ulaw_encode)
+        done = kernels->ulaw_encode(buffer, d, lsamples);
 
-    while(lsamples--) {
-        sample = *(buffer++);
-                sign = (sample >> 8) & 0x80;
-            if(sign != 0) sample = -sample;
-            sample += 0x84;
-            exponent = ulaw[(sample >> 7) & 0xff];
-            mantissa = (sample >> (exponent + 3)) & 0x0f;
-            retval = ~(sign | (exponent << 4) | mantissa);
-            if(!retval)
-            retval = 0x02;
-        *(d++) = (unsigned char)retval;
-    }
-    return count;
+    ulaw_encode_scalar(buffer + done, d + done, lsamples - done);
+    return lsamples;
 }
 
 unsigned g711u::decode(Linear buffer, void *source, unsigned lsamples)
 {
     unsigned char *src = (unsigned char *)source;
-    unsigned count;
+    const g711kernels_t *kernels;
+    unsigned count, done;
 
     count = lsamples;
 
@@ -387,44 +1425,34 @@ unsigned g711u::decode(Linear buffer, void *source, unsigned lsamples)
         56,     48,     40,     32,     24,     16,      8,      0
     };
 
+    kernels = G711_KERNELS;
+    if(kernels->ulaw_decode) {
+        done = kernels->ulaw_decode(buffer, src, lsamples);
+        buffer += done;
+        src += done;
+        lsamples -= done;
+    }
+
     while(lsamples--)
         *(buffer++) = values[*(src++)];
 
     return count;
 }
 
-#define AMI_MASK    0x55
-
 unsigned g711a::encode(Linear buffer, void *dest, unsigned lsamples)
 {
-    int mask, seg, pcm_val;
-    unsigned count;
     unsigned char *d = (unsigned char *)dest;
+    const g711kernels_t *kernels = G711_KERNELS;
+    unsigned done = 0;
 
-    static int seg_end[] = {
-        0xFF, 0x1FF, 0x3FF, 0x7FF, 0xFFF, 0x1FFF, 0x3FFF, 0x7FFF};
-
-    count = lsamples;
+    if(kernels->alaw_encode)
+        done = kernels->alaw_encode(buffer, d, lsamples);
 
-    while(lsamples--) {
-        pcm_val = *(buffer++);
-        if(pcm_val >= 0)
-            mask = AMI_MASK | 0x80;
-        else {
-            mask = AMI_MASK;
-            pcm_val = -pcm_val;
-        }
-        for(seg = 0; seg < 8; seg++)
-        {
-            if(pcm_val <= seg_end[seg])
-                break;
-        }
-        *(d++) = ((seg << 4) | ((pcm_val >> ((seg)  ?  (seg + 3)  :  4)) & 0x0F)) ^ mask;
-    }
-    return count;
+    alaw_encode_scalar(buffer + done, d + done, lsamples - done);
+    return lsamples;
 }
 
-static unsigned allevels[128] =
+__LOCAL unsigned allevels[128] =
 {
     5504,   5248,   6016,   5760,   4480,   4224,   4992,   4736,
     7552,   7296,   8064,   7808,   6528,   6272,   7040,   6784,
@@ -444,46 +1472,32 @@ static unsigned allevels[128] =
     944,    912,   1008,    976,    816,    784,    880,    848
 };
 
-Audio::Level g711a::impulse(void *data, unsigned samples)
+unsigned g711a::getLevels(levels_t& levels, void *data, unsigned samples)
 {
-    unsigned long count = samples;
-    unsigned long sum = 0;
-
-    if(!samples)
-        samples = count = 160;
-
-
-
-    unsigned char *dp = (unsigned char *)data;
+    return g711_levels(allevels, levels, data, samples);
+}
 
-    while(samples--)
-        sum += (allevels[*(dp++) & 0x7f]);
+Audio::Level g711a::impulse(void *data, unsigned samples)
+{
+    levels_t levels;
 
-    return (Level)(sum / count);
+    g711_levels(allevels, levels, data, samples);
+    return levels.mean;
 }
 
 Audio::Level g711a::peak(void *data, unsigned samples)
 {
-    unsigned long count = samples;
-    Level max = 0, value;
+    levels_t levels;
 
-    if(!samples)
-        samples = count = 160;
-
-    unsigned char *dp = (unsigned char *)data;
-
-    while(samples--) {
-        value = allevels[*(dp++) & 0x7f];
-        if(value > max)
-            max = value;
-    }
-    return max;
+    g711_levels(allevels, levels, data, samples);
+    return levels.peak;
 }
 
 unsigned g711a::decode(Linear buffer, void *source, unsigned lsamples)
 {
     unsigned char *src = (unsigned char *)source;
-    unsigned count;
+    const g711kernels_t *kernels;
+    unsigned count, done;
 
     static Sample values[256] =
     {
@@ -523,16 +1537,192 @@ unsigned g711a::decode(Linear buffer, void *source, unsigned lsamples)
 
     count = lsamples;
 
+    kernels = G711_KERNELS;
+    if(kernels->alaw_decode) {
+        done = kernels->alaw_decode(buffer, src, lsamples);
+        buffer += done;
+        src += done;
+        lsamples -= done;
+    }
+
     while(lsamples--)
         *(buffer++) = values[*(src++)];
 
     return count;
 }
 
-// adpcm codec
+// direct mu-law <-> a-law transcoding.  The maps are built at static init
+// by decoding every code and re-encoding it with the other law, so the
+// result is identical to going through a linear buffer.  Both laws keep
+// the sign in the top bit, so code b maps like b | 0x80 with the sign bit
+// flipped, except for at most one code (mu-law negative zero) which is
+// kept with its value in the two bytes past the end of the map.
 
-static short power2[15] = {1, 2, 4, 8, 0x10, 0x20, 0x40, 0x80,
-            0x100, 0x200, 0x400, 0x800, 0x1000, 0x2000, 0x4000};
+typedef unsigned (*g711remap_t)(const unsigned char *map, unsigned char *dest, const unsigned char *src, unsigned samples);
+
+static unsigned char ulaw_to_alaw[258], alaw_to_ulaw[258];
+static g711remap_t g711_remap = NULL;
+
+#ifdef  G711_AVX2
+
+// vpshufb only indexes 16 entries, so each 16 entry row of the positive
+// half of the map is looked up and kept where bits 4-6 of the code select
+// that row.
+
+static G711_AVX2_TARGET unsigned g711_remap_avx2(const unsigned char *map, unsigned char *dest, const unsigned char *src, unsigned samples)
+{
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    const __m256i high = _mm256_set1_epi8(0x07);
+    const __m256i sign = _mm256_set1_epi8((char)0x80);
+    const __m256i odd = _mm256_set1_epi8((char)map[256]);
+    const __m256i fixed = _mm256_set1_epi8((char)map[257]);
+    __m256i rows[8];
+    unsigned count = samples & ~31u;
+    unsigned pos, row;
+
+    for(row = 0; row < 8; ++row)
+        rows[row] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(map + 128 + row * 16)));
+
+    for(pos = 0; pos < count; pos += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(src + pos));
+        __m256i lo = _mm256_and_si256(x, low);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), high);
+        __m256i result = _mm256_andnot_si256(x, sign);
+
+        for(row = 0; row < 8; ++row)
+            result = _mm256_xor_si256(result, _mm256_and_si256(_mm256_cmpeq_epi8(hi, _mm256_set1_epi8((char)row)), _mm256_shuffle_epi8(rows[row], lo)));
+        result = _mm256_blendv_epi8(result, fixed, _mm256_cmpeq_epi8(x, odd));
+        _mm256_storeu_si256((__m256i *)(dest + pos), result);
+    }
+    return count;
+}
+
+#endif
+
+#if defined(G711_NEON) && defined(__aarch64__)
+
+// tbl covers 64 entries per lookup; tbx leaves lanes outside each quarter
+// of the map untouched.
+
+static unsigned g711_remap_neon(const unsigned char *map, unsigned char *dest, const unsigned char *src, unsigned samples)
+{
+    uint8x16x4_t quarter[4];
+    unsigned count = samples & ~15u;
+    unsigned pos, part, row;
+
+    for(part = 0; part < 4; ++part) {
+        for(row = 0; row < 4; ++row)
+            quarter[part].val[row] = vld1q_u8(map + part * 64 + row * 16);
+    }
+
+    for(pos = 0; pos < count; pos += 16) {
+        uint8x16_t x = vld1q_u8(src + pos);
+        uint8x16_t result = vqtbl4q_u8(quarter[0], x);
+
+        result = vqtbx4q_u8(result, quarter[1], vsubq_u8(x, vdupq_n_u8(64)));
+        result = vqtbx4q_u8(result, quarter[2], vsubq_u8(x, vdupq_n_u8(128)));
+        result = vqtbx4q_u8(result, quarter[3], vsubq_u8(x, vdupq_n_u8(192)));
+        vst1q_u8(dest + pos, result);
+    }
+    return count;
+}
+
+#endif
+
+static class __LOCAL g711maps
+{
+public:
+    g711maps();
+
+private:
+    bool fold(unsigned char *map);
+} g711_maps;
+
+g711maps::g711maps()
+{
+    unsigned char code[256];
+    Audio::Sample linear[256];
+    unsigned pos;
+
+    for(pos = 0; pos < 256; ++pos)
+        code[pos] = (unsigned char)pos;
+
+    ((AudioCodec *)&g711u)->decode(linear, code, 256);
+    alaw_encode_scalar(linear, ulaw_to_alaw, 256);
+
+    ((AudioCodec *)&g711a)->decode(linear, code, 256);
+    ulaw_encode_scalar(linear, alaw_to_ulaw, 256);
+
+    if(!fold(ulaw_to_alaw) || !fold(alaw_to_ulaw))
+        return;
+
+#ifdef  G711_AVX2
+    if(__builtin_cpu_supports("avx2"))
+        g711_remap = &g711_remap_avx2;
+#endif
+
+#if defined(G711_NEON) && defined(__aarch64__)
+    g711_remap = &g711_remap_neon;
+#endif
+}
+
+bool g711maps::fold(unsigned char *map)
+{
+    unsigned pos, odd = 0;
+
+    map[256] = 0x80;
+    map[257] = map[0x80];
+
+    for(pos = 0; pos < 128; ++pos) {
+        if(map[pos] == (map[pos | 0x80] ^ 0x80))
+            continue;
+        if(odd++)
+            return false;
+        map[256] = (unsigned char)pos;
+        map[257] = map[pos];
+    }
+    return true;
+}
+
+AudioTranscoder::AudioTranscoder(Encoding from, Encoding to)
+{
+    map = NULL;
+
+    if(from == mulawAudio && to == alawAudio)
+        map = ulaw_to_alaw;
+    else if(from == alawAudio && to == mulawAudio)
+        map = alaw_to_ulaw;
+}
+
+bool AudioTranscoder::is_direct(Encoding from, Encoding to)
+{
+    if(from == mulawAudio && to == alawAudio)
+        return true;
+
+    if(from == alawAudio && to == mulawAudio)
+        return true;
+
+    return false;
+}
+
+unsigned AudioTranscoder::process(Encoded dest, Encoded source, unsigned samples)
+{
+    unsigned pos = 0;
+
+    if(!map)
+        return 0;
+
+    if(g711_remap)
+        pos = g711_remap(map, dest, source, samples);
+
+    while(pos < samples) {
+        dest[pos] = map[source[pos]];
+        ++pos;
+    }
+    return samples;
+}
+
+// adpcm codec
 
 typedef struct state {
     long yl;
@@ -561,10 +1751,45 @@ static int quan(
     return (i);
 }
 
+// quan() against power2[], which every predictor tap and both floating
+// point conversions in update() run: the bit length of val limited to 15,
+// or 0 when val is not positive.
+
+#ifndef __GNUC__
+static short power2[15] = {1, 2, 4, 8, 0x10, 0x20, 0x40, 0x80,
+            0x100, 0x200, 0x400, 0x800, 0x1000, 0x2000, 0x4000};
+#endif
+
+static inline int quan2(int val)
+{
+#ifdef  __GNUC__
+    if(val <= 0)
+        return 0;
+    val = 32 - __builtin_clz((unsigned)val);
+    return (val > 15) ? 15 : val;
+#else
+    return quan(val, power2, 15);
+#endif
+}
+
+// quan() of the normalized log against each quantization table is a
+// direct lookup.  dl is at most 2047 and y stays within 544..5120, so
+// dln always falls inside +/- QUAN_RANGE / 2.
+
+#define QUAN_RANGE  4096
+
+static void quan_fill(unsigned char *lookup, short *table, int size)
+{
+    int val;
+
+    for(val = 0; val < QUAN_RANGE; ++val)
+        lookup[val] = (unsigned char)quan(val - QUAN_RANGE / 2, table, size);
+}
+
 static int quantize(
     int     d,  /* Raw difference signal sample */
     int     y,  /* Step size multiplier */
-    short       *table, /* quantization table */
+    const unsigned char *lookup, /* quan() of the quantization table */
     int     size)   /* table size of short integers */
 {
     short       dqm;    /* Magnitude of 'd' */
@@ -580,7 +1805,7 @@ static int quantize(
      * Compute base 2 log of 'd', and store in 'dl'.
      */
     dqm = abs(d);
-    exp = quan(dqm >> 1, power2, 15);
+    exp = quan2(dqm >> 1);
     mant = ((dqm << 7) >> exp) & 0x7F;  /* Fractional portion. */
     dl = (exp << 7) + mant;
 
@@ -596,7 +1821,7 @@ static int quantize(
      *
      * Obtain codword i for 'd'.
      */
-    i = quan(dln, table, size);
+    i = lookup[dln + QUAN_RANGE / 2];
     if (d < 0)          /* take 1's complement of i */
         return ((size << 1) + 1 - i);
     else if (i == 0)        /* take 1's complement of 0 */
@@ -614,7 +1839,7 @@ static int fmult(
     short       retval;
 
     anmag = (an > 0) ? an : ((-an) & 0x1FFF);
-    anexp = quan(anmag, power2, 15) - 6;
+    anexp = quan2(anmag) - 6;
     anmant = (anmag == 0) ? 32 :
         (anexp >= 0) ? anmag >> anexp : anmag << -anexp;
     wanexp = anexp + ((srn >> 6) & 0xF) - 13;
@@ -786,7 +2011,7 @@ static void update(
     if (mag == 0) {
         state_ptr->dq[0] = (dq >= 0) ? 0x20 : 0xFC20;
     } else {
-        exp = quan(mag, power2, 15);
+        exp = quan2(mag);
         state_ptr->dq[0] = (dq >= 0) ?
             (exp << 6) + ((mag << 6) >> exp) :
             (exp << 6) + ((mag << 6) >> exp) - 0x400;
@@ -797,11 +2022,11 @@ static void update(
     if (sr == 0) {
         state_ptr->sr[0] = 0x20;
     } else if (sr > 0) {
-        exp = quan(sr, power2, 15);
+        exp = quan2(sr);
         state_ptr->sr[0] = (exp << 6) + ((sr << 6) >> exp);
     } else if (sr > -32768) {
         mag = -sr;
-        exp = quan(mag, power2, 15);
+        exp = quan2(mag);
         state_ptr->sr[0] =  (exp << 6) + ((mag << 6) >> exp) - 0x400;
     } else
         state_ptr->sr[0] = (short)0xFC20;
@@ -877,6 +2102,153 @@ static int step_size(
     }
 }
 
+static void init_state(state_t *state_ptr)
+{
+    unsigned pos;
+
+    memset(state_ptr, 0, sizeof(state_t));
+    state_ptr->yl = 34816;
+    state_ptr->yu = 544;
+    state_ptr->sr[0] = state_ptr->sr[1] = 32;
+
+    for(pos = 0; pos < 6; ++pos)
+        state_ptr->dq[pos] = 32;
+}
+
+// describes one of the g.721/g.723 variants for the multi-channel engine
+
+typedef struct {
+    Audio::Encoding encoding;
+    unsigned bits;          // code size
+    unsigned frame;         // samples in a packed frame
+    int sign;               // sign bit of a code
+    int mask;               // magnitude mask of dq
+    int wshift;             // scale of the witab entries
+    bool wide;              // encoder forms se without truncating (g.721)
+    short *dqlntab, *witab, *fitab, *qtab;
+    int qsize;
+    unsigned char *qlook;   // quan() of qtab, by dln
+}   g726_profile_t;
+
+// g.721/g.723 code packing.  Every variant stores its codes low bits
+// first, so eight codes of n bits always fill exactly n bytes.  Whole
+// groups of eight go through the bound packer, which on x86-64 with bmi2
+// is a single pext or pdep per group; a short tail is padded to a group.
+
+#define G726_BLOCK  64
+
+#if defined(G711_AVX2) && defined(__x86_64__)
+#define G726_BMI2
+#define G726_BMI2_TARGET __attribute__((target("bmi2")))
+#endif
+
+typedef void (*g726pack_t)(Audio::Encoded dest, const unsigned char *codes, unsigned bits, unsigned groups);
+typedef void (*g726unpack_t)(unsigned char *codes, const unsigned char *src, unsigned bits, unsigned groups);
+
+static void g726_pack_scalar(Audio::Encoded dest, const unsigned char *codes, unsigned bits, unsigned groups)
+{
+    uint64_t data;
+    unsigned pos;
+
+    while(groups--) {
+        data = 0;
+        for(pos = 0; pos < 8; ++pos)
+            data |= (uint64_t)codes[pos] << (pos * bits);
+        for(pos = 0; pos < bits; ++pos) {
+            *(dest++) = (unsigned char)data;
+            data >>= 8;
+        }
+        codes += 8;
+    }
+}
+
+static void g726_unpack_scalar(unsigned char *codes, const unsigned char *src, unsigned bits, unsigned groups)
+{
+    uint64_t data;
+    unsigned pos, mask = (1u << bits) - 1;
+
+    while(groups--) {
+        data = 0;
+        for(pos = 0; pos < bits; ++pos)
+            data |= (uint64_t)src[pos] << (pos * 8);
+        for(pos = 0; pos < 8; ++pos) {
+            codes[pos] = (unsigned char)(data & mask);
+            data >>= bits;
+        }
+        src += bits;
+        codes += 8;
+    }
+}
+
+#ifdef  G726_BMI2
+
+static G726_BMI2_TARGET void g726_pack_bmi2(Audio::Encoded dest, const unsigned char *codes, unsigned bits, unsigned groups)
+{
+    uint64_t mask = 0x0101010101010101ull * ((1u << bits) - 1);
+    uint64_t data;
+
+    while(groups--) {
+        memcpy(&data, codes, 8);
+        data = _pext_u64(data, mask);
+        memcpy(dest, &data, bits);
+        codes += 8;
+        dest += bits;
+    }
+}
+
+static G726_BMI2_TARGET void g726_unpack_bmi2(unsigned char *codes, const unsigned char *src, unsigned bits, unsigned groups)
+{
+    uint64_t mask = 0x0101010101010101ull * ((1u << bits) - 1);
+    uint64_t data;
+
+    while(groups--) {
+        data = 0;
+        memcpy(&data, src, bits);
+        data = _pdep_u64(data, mask);
+        memcpy(codes, &data, 8);
+        codes += 8;
+        src += bits;
+    }
+}
+
+#endif
+
+static g726pack_t g726_packer = &g726_pack_scalar;
+static g726unpack_t g726_unpacker = &g726_unpack_scalar;
+
+// count is a whole number of codec frames, so count * bits is whole bytes
+static void g726_pack(Audio::Encoded dest, const unsigned char *codes, unsigned bits, unsigned count)
+{
+    unsigned char tail[8];
+    unsigned char packed[8];
+    unsigned groups = count / 8;
+
+    g726_packer(dest, codes, bits, groups);
+    count -= groups * 8;
+    if(!count)
+        return;
+
+    memset(tail, 0, sizeof(tail));
+    memcpy(tail, codes + groups * 8, count);
+    g726_pack_scalar(packed, tail, bits, 1);
+    memcpy(dest + groups * bits, packed, (count * bits) / 8);
+}
+
+static void g726_unpack(unsigned char *codes, const unsigned char *src, unsigned bits, unsigned count)
+{
+    unsigned char tail[8];
+    unsigned groups = count / 8;
+
+    g726_unpacker(codes, src, bits, groups);
+    count -= groups * 8;
+    if(!count)
+        return;
+
+    memset(tail, 0, sizeof(tail));
+    memcpy(tail, src + groups * bits, (count * bits) / 8);
+    g726_unpack_scalar(codes + groups * 8, tail, bits, 1);
+}
+
 static class __LOCAL g721Codec : private AudioCodec
 {
 private:
@@ -889,6 +2261,7 @@ private:
 
     state_t encode_state, decode_state;
 
+    bool reset(void) __FINAL;
     AudioCodec *getByInfo(Info &info) __FINAL;
     AudioCodec *getByFormat(const char *format) __FINAL;
 
@@ -898,6 +2271,8 @@ private:
     unsigned char encoder(short sl, state_t *state);
 
 public:
+    static const g726_profile_t profile;
+
     g721Codec(const char *id, Encoding e);
     g721Codec();
     ~g721Codec();
@@ -915,6 +2290,7 @@ private:
 
     state_t encode_state, decode_state;
 
+    bool reset(void) __FINAL;
     AudioCodec *getByInfo(Info &info) __FINAL;
     AudioCodec *getByFormat(const char *format) __FINAL;
 
@@ -924,6 +2300,8 @@ private:
     unsigned char encoder(short sl, state_t *state);
 
 public:
+    static const g726_profile_t profile;
+
     g723_3Codec(const char *id, Encoding e);
     g723_3Codec();
     ~g723_3Codec();
@@ -941,6 +2319,7 @@ private:
 
     state_t encode_state, decode_state;
 
+    bool reset(void) __FINAL;
     AudioCodec *getByInfo(Info &info)  __FINAL;
     AudioCodec *getByFormat(const char *format)  __FINAL;
 
@@ -950,6 +2329,8 @@ private:
     unsigned char encoder(short sl, state_t *state);
 
 public:
+    static const g726_profile_t profile;
+
     g723_5Codec(const char *id, Encoding e);
     g723_5Codec();
     ~g723_5Codec();
@@ -967,6 +2348,7 @@ private:
 
     state_t encode_state, decode_state;
 
+    bool reset(void) __FINAL;
     AudioCodec *getByInfo(Info &info) __FINAL;
     AudioCodec *getByFormat(const char *format) __FINAL;
 
@@ -976,6 +2358,8 @@ private:
     unsigned char encoder(short sl, state_t *state);
 
 public:
+    static const g726_profile_t profile;
+
     g723_2Codec(const char *id, Encoding e);
     g723_2Codec();
     ~g723_2Codec();
@@ -1018,24 +2402,46 @@ short g721Codec::_fitab[16] = {0, 0, 0, 0x200, 0x200, 0x200, 0x600, 0xE00,
                 0xE00, 0x600, 0x200, 0x200, 0x200, 0, 0, 0};
 short g721Codec::qtab_721[7] = {-124, 80, 178, 246, 300, 349, 400};
 
-g723_3Codec::g723_3Codec() : AudioCodec()
+static unsigned char quan_721[QUAN_RANGE], quan_723_16[QUAN_RANGE];
+static unsigned char quan_723_24[QUAN_RANGE], quan_723_40[QUAN_RANGE];
+
+const g726_profile_t g721Codec::profile = {Audio::g721ADPCM, 4, 2, 0x08, 0x3fff, 5, true,
+    _dqlntab, _witab, _fitab, qtab_721, 7, quan_721};
+
+const g726_profile_t g723_2Codec::profile = {Audio::g723_2bit, 2, 4, 0x02, 0x3fff, 0, false,
+    _dqlntab, _witab, _fitab, qtab_723_16, 1, quan_723_16};
+
+const g726_profile_t g723_3Codec::profile = {Audio::g723_3bit, 3, 8, 0x04, 0x3fff, 0, false,
+    _dqlntab, _witab, _fitab, qtab_723_24, 3, quan_723_24};
+
+const g726_profile_t g723_5Codec::profile = {Audio::g723_5bit, 5, 8, 0x10, 0x7fff, 0, false,
+    _dqlntab, _witab, _fitab, qtab_723_40, 15, quan_723_40};
+
+static class __LOCAL quanselect
+{
+public:
+    quanselect();
+} quan_select;
+
+quanselect::quanselect()
 {
+    const g726_profile_t *profiles[] = {&g721Codec::profile, &g723_2Codec::profile,
+        &g723_3Codec::profile, &g723_5Codec::profile};
     unsigned pos;
 
+    for(pos = 0; pos < 4; ++pos)
+        quan_fill(profiles[pos]->qlook, profiles[pos]->qtab, profiles[pos]->qsize);
+}
+
+g723_3Codec::g723_3Codec() : AudioCodec()
+{
     info.framesize = 3;
     info.framecount = 8;
     info.bitrate = 24000;
     info.encoding = g723_3bit;
     info.annotation = (char *)"g.723/3";
     info.rate = 8000;
-    memset(&encode_state, 0, sizeof(encode_state));
-    memset(&decode_state, 0, sizeof(decode_state));
-    encode_state.yl = decode_state.yl = 34816;
-    encode_state.yu = decode_state.yu = 544;
-    encode_state.sr[0] = encode_state.sr[1] = decode_state.sr[0] = decode_state.sr[1] = 32;
-
-    for(pos = 0; pos < 6; ++pos)
-        encode_state.dq[pos] = decode_state.dq[pos] = 32;
+    reset();
 }
 
 g723_3Codec::g723_3Codec(const char *id, Encoding e) : AudioCodec(id, e)
@@ -1050,6 +2456,13 @@ g723_3Codec::g723_3Codec(const char *id, Encoding e) : AudioCodec(id, e)
 g723_3Codec::~g723_3Codec()
 {}
 
+bool g723_3Codec::reset(void)
+{
+    init_state(&encode_state);
+    init_state(&decode_state);
+    return true;
+}
+
 
 unsigned char g723_3Codec::encoder(short sl, state_t *state_ptr)
 {
@@ -1067,7 +2480,7 @@ unsigned char g723_3Codec::encoder(short sl, state_t *state_ptr)
 
     /* quantize prediction difference d */
     y = step_size(state_ptr);       /* quantizer step size */
-    i = quantize(d, y, qtab_723_24, 3);     /* i = ADPCM code */
+    i = quantize(d, y, profile.qlook, 3);     /* i = ADPCM code */
     dq = reconstruct(i & 4, _dqlntab[i], y); /* quantized diff. */
 
     sr = (dq < 0) ? se - (dq & 0x3FFF) : se + dq; /* reconstructed signal */
@@ -1102,79 +2515,69 @@ short g723_3Codec::coder(state_t *state_ptr, int i)
 
 unsigned g723_3Codec::encode(Linear buffer, void *coded, unsigned lsamples)
 {
-    unsigned count = (lsamples / 8);
+    unsigned count = (lsamples / 8) * 8;
     Encoded dest = (Encoded)coded;
-    unsigned i, data, byte, bits;
-
-    while(count--) {
-        bits = 0;
-        data = 0;
-        for(i = 0; i < 8; ++i)
-        {
-            byte = encoder(*(buffer++), &encode_state);
-            data |= (byte << bits);
-            bits += 3;
-            if(bits >= 8) {
-                *(dest++) = (data & 0xff);
-                bits -= 8;
-                data >>= 8;
-            }
-        }
+    unsigned char codes[G726_BLOCK];
+    unsigned block, pos;
+
+    while(count) {
+        block = (count > G726_BLOCK) ? G726_BLOCK : count;
+        for(pos = 0; pos < block; ++pos)
+            codes[pos] = encoder(*(buffer++), &encode_state);
+        g726_pack(dest, codes, 3, block);
+        dest += (block * 3) / 8;
+        count -= block;
     }
     return (lsamples / 8) * 8;
 }
 
 unsigned g723_3Codec::decode(Linear buffer, void *from, unsigned lsamples)
 {
-    Encoded src = (Encoded)from;
     unsigned count = (lsamples / 8) * 8;
-    unsigned char byte, nib;
-    unsigned bits = 0, data = 0;
-
-    while(count--) {
-        if(bits < 3) {
-            byte = *(src++);
-            data |= (byte << bits);
-            bits += 8;
-        }
-        nib = data & 0x07;
-        data >>= 3;
-        bits -= 3;
-        *(buffer++) = coder(&decode_state, nib);
+    Encoded src = (Encoded)from;
+    unsigned char codes[G726_BLOCK];
+    unsigned block, pos;
+
+    while(count) {
+        block = (count > G726_BLOCK) ? G726_BLOCK : count;
+        g726_unpack(codes, src, 3, block);
+        for(pos = 0; pos < block; ++pos)
+            *(buffer++) = coder(&decode_state, codes[pos]);
+        src += (block * 3) / 8;
+        count -= block;
     }
     return (lsamples / 8) * 8;
 }
 
 AudioCodec *g723_3Codec::getByInfo(Info &info)
 {
-    return (AudioCodec *)new g723_3Codec();
+    AudioCodec *codec = reuse(g723_3bit);
+
+    if(!codec)
+        codec = (AudioCodec *)new g723_3Codec();
+    return codec;
 }
 
 AudioCodec *g723_3Codec::getByFormat(const char *format)
 {
-    return (AudioCodec *)new g723_3Codec();
+    AudioCodec *codec = reuse(g723_3bit);
+
+    if(!codec)
+        codec = (AudioCodec *)new g723_3Codec();
+    return codec;
 }
 
 
 
 g723_2Codec::g723_2Codec() : AudioCodec()
 {
-    unsigned pos;
-
     info.framesize = 1;
     info.framecount = 4;
     info.bitrate = 16000;
-    info.encoding = g723_3bit;
+    info.encoding = g723_2bit;
     info.annotation = (char *)"g.723/2";
     info.rate = 8000;
-    memset(&encode_state, 0, sizeof(encode_state));
-    memset(&decode_state, 0, sizeof(decode_state));
-    encode_state.yl = decode_state.yl = 34816;
-    encode_state.yu = decode_state.yu = 544;
-    encode_state.sr[0] = encode_state.sr[1] = decode_state.sr[0] = decode_state.sr[1] = 32;
-
-    for(pos = 0; pos < 6; ++pos)
-        encode_state.dq[pos] = decode_state.dq[pos] = 32;
+    reset();
 }
 
 g723_2Codec::g723_2Codec(const char *id, Encoding e) : AudioCodec(id, e)
@@ -1189,6 +2592,13 @@ g723_2Codec::g723_2Codec(const char *id, Encoding e) : AudioCodec(id, e)
 g723_2Codec::~g723_2Codec()
 {}
 
+bool g723_2Codec::reset(void)
+{
+    init_state(&encode_state);
+    init_state(&decode_state);
+    return true;
+}
+
 unsigned char g723_2Codec::encoder(short sl, state_t *state_ptr)
 {
     short sezi, se, sez, sei;
@@ -1205,7 +2615,7 @@ unsigned char g723_2Codec::encoder(short sl, state_t *state_ptr)
 
     /* quantize prediction difference d */
     y = step_size(state_ptr);       /* quantizer step size */
-    i = quantize(d, y, qtab_723_16, 1);  /* i = ADPCM code */
+    i = quantize(d, y, profile.qlook, 1);  /* i = ADPCM code */
 
       /* Since quantize() only produces a three level output
        * (1, 2, or 3), we must create the fourth one on our own
@@ -1252,77 +2662,67 @@ short g723_2Codec::coder(state_t *state_ptr, int i)
 
 unsigned g723_2Codec::encode(Linear buffer, void *coded, unsigned lsamples)
 {
-    unsigned count = (lsamples / 4);
+    unsigned count = (lsamples / 4) * 4;
     Encoded dest = (Encoded)coded;
-    unsigned i, data, byte, bits;
-
-    while(count--) {
-        bits = 0;
-        data = 0;
-        for(i = 0; i < 4; ++i)
-        {
-            byte = encoder(*(buffer++), &encode_state);
-            data |= (byte << bits);
-            bits += 2;
-            if(bits >= 8) {
-                *(dest++) = (data & 0xff);
-                bits -= 8;
-                data >>= 8;
-            }
-        }
+    unsigned char codes[G726_BLOCK];
+    unsigned block, pos;
+
+    while(count) {
+        block = (count > G726_BLOCK) ? G726_BLOCK : count;
+        for(pos = 0; pos < block; ++pos)
+            codes[pos] = encoder(*(buffer++), &encode_state);
+        g726_pack(dest, codes, 2, block);
+        dest += (block * 2) / 8;
+        count -= block;
     }
     return (lsamples / 4) * 4;
 }
 
 unsigned g723_2Codec::decode(Linear buffer, void *from, unsigned lsamples)
 {
-    Encoded src = (Encoded)from;
     unsigned count = (lsamples / 4) * 4;
-    unsigned char byte, nib;
-    unsigned bits = 0, data = 0;
-
-    while(count--) {
-        if(bits < 2) {
-            byte = *(src++);
-            data |= (byte << bits);
-            bits += 8;
-        }
-        nib = data & 0x03;
-        data >>= 2;
-        bits -= 2;
-        *(buffer++) = coder(&decode_state, nib);
+    Encoded src = (Encoded)from;
+    unsigned char codes[G726_BLOCK];
+    unsigned block, pos;
+
+    while(count) {
+        block = (count > G726_BLOCK) ? G726_BLOCK : count;
+        g726_unpack(codes, src, 2, block);
+        for(pos = 0; pos < block; ++pos)
+            *(buffer++) = coder(&decode_state, codes[pos]);
+        src += (block * 2) / 8;
+        count -= block;
     }
     return (lsamples / 4) * 4;
 }
 
 AudioCodec *g723_2Codec::getByInfo(Info &info)
 {
-    return (AudioCodec *)new g723_2Codec();
+    AudioCodec *codec = reuse(g723_2bit);
+
+    if(!codec)
+        codec = (AudioCodec *)new g723_2Codec();
+    return codec;
 }
 
 AudioCodec *g723_2Codec::getByFormat(const char *format)
 {
-    return (AudioCodec *)new g723_2Codec();
+    AudioCodec *codec = reuse(g723_2bit);
+
+    if(!codec)
+        codec = (AudioCodec *)new g723_2Codec();
+    return codec;
 }
 
 g723_5Codec::g723_5Codec() : AudioCodec()
 {
-    unsigned pos;
-
     info.framesize = 5;
     info.framecount = 8;
     info.bitrate = 40000;
     info.encoding = g723_5bit;
     info.annotation = (char *)"g.723/5";
     info.rate = 8000;
-    memset(&encode_state, 0, sizeof(encode_state));
-    memset(&decode_state, 0, sizeof(decode_state));
-    encode_state.yl = decode_state.yl = 34816;
-    encode_state.yu = decode_state.yu = 544;
-    encode_state.sr[0] = encode_state.sr[1] = decode_state.sr[0] = decode_state.sr[1] = 32;
-
-    for(pos = 0; pos < 6; ++pos)
-        encode_state.dq[pos] = decode_state.dq[pos] = 32;
+    reset();
 }
 
 g723_5Codec::g723_5Codec(const char *id, Encoding e) : AudioCodec(id, e)
@@ -1337,6 +2737,13 @@ g723_5Codec::g723_5Codec(const char *id, Encoding e) : AudioCodec(id, e)
 g723_5Codec::~g723_5Codec()
 {}
 
+bool g723_5Codec::reset(void)
+{
+    init_state(&encode_state);
+    init_state(&decode_state);
+    return true;
+}
+
 unsigned char g723_5Codec::encoder(short sl, state_t *state_ptr)
 {
     short           sei, sezi, se, sez;     /* ACCUM */
@@ -1357,218 +2764,907 @@ unsigned char g723_5Codec::encoder(short sl, state_t *state_ptr)
 
     /* quantize prediction difference */
     y = step_size(state_ptr);       /* adaptive quantizer step size */
-    i = quantize(d, y, qtab_723_40, 15);    /* i = ADPCM code */
+    i = quantize(d, y, profile.qlook, 15);    /* i = ADPCM code */
+
+    dq = reconstruct(i & 0x10, _dqlntab[i], y);     /* quantized diff */
+
+    sr = (dq < 0) ? se - (dq & 0x7FFF) : se + dq; /* reconstructed signal */
+    dqsez = sr + sez - se;          /* dqsez = pole prediction diff. */
+
+    update(5, y, _witab[i], _fitab[i], dq, sr, dqsez, state_ptr);
+
+    return (unsigned char)(i);
+}
+
+short g723_5Codec::coder(state_t *state_ptr, int i)
+{
+    short           sezi, sei, sez, se;     /* ACCUM */
+    short           y;                 /* MIX */
+    short           sr;                     /* ADDB */
+    short           dq;
+    short           dqsez;
+
+    i &= 0x1f;                      /* mask to get proper bits */
+    sezi = predictor_zero(state_ptr);
+    sez = sezi >> 1;
+    sei = sezi + predictor_pole(state_ptr);
+    se = sei >> 1;                  /* se = estimated signal */
+
+    y = step_size(state_ptr);       /* adaptive quantizer step size */
+    dq = reconstruct(i & 0x10, _dqlntab[i], y);     /* estimation diff. */
+
+    sr = (dq < 0) ? (se - (dq & 0x7FFF)) : (se + dq); /* reconst. signal */
+
+    dqsez = sr - se + sez;          /* pole prediction diff. */
+
+    update(5, y, _witab[i], _fitab[i], dq, sr, dqsez, state_ptr);
+    return sr << 2;
+}
+
+unsigned g723_5Codec::encode(Linear buffer, void *coded, unsigned lsamples)
+{
+    unsigned count = (lsamples / 8) * 8;
+    Encoded dest = (Encoded)coded;
+    unsigned char codes[G726_BLOCK];
+    unsigned block, pos;
+
+    while(count) {
+        block = (count > G726_BLOCK) ? G726_BLOCK : count;
+        for(pos = 0; pos < block; ++pos)
+            codes[pos] = encoder(*(buffer++), &encode_state);
+        g726_pack(dest, codes, 5, block);
+        dest += (block * 5) / 8;
+        count -= block;
+    }
+    return (lsamples / 8) * 8;
+}
+
+unsigned g723_5Codec::decode(Linear buffer, void *from, unsigned lsamples)
+{
+    unsigned count = (lsamples / 8) * 8;
+    Encoded src = (Encoded)from;
+    unsigned char codes[G726_BLOCK];
+    unsigned block, pos;
+
+    while(count) {
+        block = (count > G726_BLOCK) ? G726_BLOCK : count;
+        g726_unpack(codes, src, 5, block);
+        for(pos = 0; pos < block; ++pos)
+            *(buffer++) = coder(&decode_state, codes[pos]);
+        src += (block * 5) / 8;
+        count -= block;
+    }
+    return (lsamples / 8) * 8;
+}
+
+AudioCodec *g723_5Codec::getByInfo(Info &info)
+{
+    AudioCodec *codec = reuse(g723_5bit);
+
+    if(!codec)
+        codec = (AudioCodec *)new g723_5Codec();
+    return codec;
+}
+
+AudioCodec *g723_5Codec::getByFormat(const char *format)
+{
+    AudioCodec *codec = reuse(g723_5bit);
+
+    if(!codec)
+        codec = (AudioCodec *)new g723_5Codec();
+    return codec;
+}
+
+g721Codec::g721Codec() : AudioCodec()
+{
+    info.framesize = 1;
+    info.framecount = 2;
+    info.rate = 8000;
+    info.bitrate = 32000;
+    info.annotation = (char *)"g.721";
+    info.encoding = g721ADPCM;
+
+    reset();
+}
+
+g721Codec::g721Codec(const char *id, Encoding e) : AudioCodec(id, e)
+{
+    info.framesize = 1;
+    info.framecount = 2;
+    info.rate = 8000;
+    info.bitrate = 32000;
+    info.annotation = (char *)"g.721";
+}
+
+g721Codec::~g721Codec()
+{}
+
+bool g721Codec::reset(void)
+{
+    init_state(&encode_state);
+    init_state(&decode_state);
+    return true;
+}
+
+unsigned char g721Codec::encoder(short sl, state_t *state)
+{
+    short sezi, se, sez;
+    short d, sr, y, dqsez, dq, i;
+
+    sl >>= 2;
+
+    sezi = predictor_zero(state);
+    sez = sezi >> 1;
+    se = (sezi + predictor_pole(state)) >> 1;
+
+    d = sl - se;
+
+    y = step_size(state);
+    i = quantize(d, y, profile.qlook, 7);
+    dq = reconstruct(i & 8, _dqlntab[i], y);
+    sr = (dq < 0) ? se - (dq & 0x3FFF) : se + dq;
+
+    dqsez = sr + sez - se;
+
+    update(4, y, _witab[i] << 5, _fitab[i], dq, sr, dqsez, state);
+
+    return (unsigned char)(i);
+}
+
+short g721Codec::coder(state_t *state, int i)
+{
+    short sezi, sei, sez, se;
+    short y, sr, dq, dqsez;
+
+    sezi = predictor_zero(state);
+    sez = sezi >> 1;
+    sei = sezi + predictor_pole(state);
+    se = sei >> 1;
+    y = step_size(state);
+    dq = reconstruct(i & 0x08, _dqlntab[i], y);
+    sr = (dq < 0) ? (se - (dq & 0x3fff)) : se + dq;
+    dqsez = sr - se + sez;
+    update(4, y, _witab[i] << 5, _fitab[i], dq, sr, dqsez, state);
+    return sr << 2;
+}
+
+unsigned g721Codec::encode(Linear buffer, void *coded, unsigned lsamples)
+{
+    unsigned count = (lsamples / 2) * 2;
+    Encoded dest = (Encoded)coded;
+    unsigned char codes[G726_BLOCK];
+    unsigned block, pos;
+
+    while(count) {
+        block = (count > G726_BLOCK) ? G726_BLOCK : count;
+        for(pos = 0; pos < block; ++pos)
+            codes[pos] = encoder(*(buffer++), &encode_state);
+        g726_pack(dest, codes, 4, block);
+        dest += (block * 4) / 8;
+        count -= block;
+    }
+    return (lsamples / 2) * 2;
+}
+
+unsigned g721Codec::decode(Linear buffer, void *from, unsigned lsamples)
+{
+    unsigned count = (lsamples / 2) * 2;
+    Encoded src = (Encoded)from;
+    unsigned char codes[G726_BLOCK];
+    unsigned block, pos;
+
+    while(count) {
+        block = (count > G726_BLOCK) ? G726_BLOCK : count;
+        g726_unpack(codes, src, 4, block);
+        for(pos = 0; pos < block; ++pos)
+            *(buffer++) = coder(&decode_state, codes[pos]);
+        src += (block * 4) / 8;
+        count -= block;
+    }
+    return (lsamples / 2) * 2;
+}
+
+AudioCodec *g721Codec::getByInfo(Info &info)
+{
+    AudioCodec *codec = reuse(g721ADPCM);
+
+    if(!codec)
+        codec = (AudioCodec *)new g721Codec();
+    return codec;
+}
+
+AudioCodec *g721Codec::getByFormat(const char *format)
+{
+    AudioCodec *codec = reuse(g721ADPCM);
+
+    if(!codec)
+        codec = (AudioCodec *)new g721Codec();
+    return codec;
+}
+
+// multi-channel g.721/g.723 engine.  Channel state is kept in groups of
+// eight lanes with each state_t field in its own array, so a whole group
+// is stepped with one vector operation per field.  A lane holds the sign
+// extended value of its state_t field, and the kernel truncates to 16 bits
+// everywhere the scalar coders assign to a short, so that both paths stay
+// bit exact.  The scalar coders below remain the reference.
+
+#define G726_LANES  8
+
+typedef struct {
+    int yl[G726_LANES], yu[G726_LANES];
+    int dms[G726_LANES], dml[G726_LANES];
+    int ap[G726_LANES], td[G726_LANES];
+    int a[2][G726_LANES], b[6][G726_LANES], pk[2][G726_LANES];
+    int dq[6][G726_LANES], sr[2][G726_LANES];
+}   g726_lanes_t;
+
+typedef void (*g726coder_t)(const g726_profile_t *p, g726_lanes_t *lanes, Audio::Linear *buffers, Audio::Encoded *coded, unsigned count, unsigned samples);
+
+static g726coder_t g726_encode_kernel = NULL, g726_decode_kernel = NULL;
+
+// the bank has its own engine switch, apart from the g.711 one
+static bool g726_scalar = false;
+
+#ifdef  __GNUC__
+#define G726_SCALAR             __atomic_load_n(&g726_scalar, __ATOMIC_RELAXED)
+#else
+#define G726_SCALAR             g726_scalar
+#endif
+
+static void g726_load(const g726_lanes_t *lanes, unsigned lane, state_t *state)
+{
+    unsigned pos;
+
+    state->yl = lanes->yl[lane];
+    state->yu = (short)lanes->yu[lane];
+    state->dms = (short)lanes->dms[lane];
+    state->dml = (short)lanes->dml[lane];
+    state->ap = (short)lanes->ap[lane];
+    state->td = (char)lanes->td[lane];
+
+    for(pos = 0; pos < 2; ++pos) {
+        state->a[pos] = (short)lanes->a[pos][lane];
+        state->pk[pos] = (short)lanes->pk[pos][lane];
+        state->sr[pos] = (short)lanes->sr[pos][lane];
+    }
+
+    for(pos = 0; pos < 6; ++pos) {
+        state->b[pos] = (short)lanes->b[pos][lane];
+        state->dq[pos] = (short)lanes->dq[pos][lane];
+    }
+}
+
+static void g726_store(g726_lanes_t *lanes, unsigned lane, const state_t *state)
+{
+    unsigned pos;
+
+    lanes->yl[lane] = (int)state->yl;
+    lanes->yu[lane] = state->yu;
+    lanes->dms[lane] = state->dms;
+    lanes->dml[lane] = state->dml;
+    lanes->ap[lane] = state->ap;
+    lanes->td[lane] = state->td;
+
+    for(pos = 0; pos < 2; ++pos) {
+        lanes->a[pos][lane] = state->a[pos];
+        lanes->pk[pos][lane] = state->pk[pos];
+        lanes->sr[pos][lane] = state->sr[pos];
+    }
+
+    for(pos = 0; pos < 6; ++pos) {
+        lanes->b[pos][lane] = state->b[pos];
+        lanes->dq[pos][lane] = state->dq[pos];
+    }
+}
+
+// scalar coders, the same steps as the per-codec encoder() and coder()
+
+static unsigned char g726_encoder(const g726_profile_t *p, short sl, state_t *state_ptr)
+{
+    short sezi, se, sez, sei;
+    short d, sr, y, dqsez, dq, i;
+
+    sl >>= 2;
+
+    sezi = predictor_zero(state_ptr);
+    sez = sezi >> 1;
+    if(p->wide)
+        se = (sezi + predictor_pole(state_ptr)) >> 1;
+    else {
+        sei = sezi + predictor_pole(state_ptr);
+        se = sei >> 1;
+    }
 
-    dq = reconstruct(i & 0x10, _dqlntab[i], y);     /* quantized diff */
+    d = sl - se;
 
-    sr = (dq < 0) ? se - (dq & 0x7FFF) : se + dq; /* reconstructed signal */
-    dqsez = sr + sez - se;          /* dqsez = pole prediction diff. */
+    y = step_size(state_ptr);
+    i = quantize(d, y, p->qlook, p->qsize);
+    if(p->bits == 2 && i == 3 && (d & 0x8000) == 0)
+        i = 0;
 
-    update(5, y, _witab[i], _fitab[i], dq, sr, dqsez, state_ptr);
+    dq = reconstruct(i & p->sign, p->dqlntab[i], y);
+    sr = (dq < 0) ? se - (dq & p->mask) : se + dq;
+    dqsez = sr + sez - se;
 
+    update(p->bits, y, p->witab[i] << p->wshift, p->fitab[i], dq, sr, dqsez, state_ptr);
     return (unsigned char)(i);
 }
 
-short g723_5Codec::coder(state_t *state_ptr, int i)
+static short g726_coder(const g726_profile_t *p, int i, state_t *state_ptr)
 {
-    short           sezi, sei, sez, se;     /* ACCUM */
-    short           y;                 /* MIX */
-    short           sr;                     /* ADDB */
-    short           dq;
-    short           dqsez;
+    short sezi, sei, sez, se;
+    short y, sr, dq, dqsez;
 
-    i &= 0x1f;                      /* mask to get proper bits */
     sezi = predictor_zero(state_ptr);
     sez = sezi >> 1;
     sei = sezi + predictor_pole(state_ptr);
-    se = sei >> 1;                  /* se = estimated signal */
-
-    y = step_size(state_ptr);       /* adaptive quantizer step size */
-    dq = reconstruct(i & 0x10, _dqlntab[i], y);     /* estimation diff. */
-
-    sr = (dq < 0) ? (se - (dq & 0x7FFF)) : (se + dq); /* reconst. signal */
+    se = sei >> 1;
 
-    dqsez = sr - se + sez;          /* pole prediction diff. */
+    y = step_size(state_ptr);
+    dq = reconstruct(i & p->sign, p->dqlntab[i], y);
+    sr = (dq < 0) ? (se - (dq & p->mask)) : se + dq;
+    dqsez = sr - se + sez;
 
-    update(5, y, _witab[i], _fitab[i], dq, sr, dqsez, state_ptr);
+    update(p->bits, y, p->witab[i] << p->wshift, p->fitab[i], dq, sr, dqsez, state_ptr);
     return sr << 2;
 }
 
-unsigned g723_5Codec::encode(Linear buffer, void *coded, unsigned lsamples)
+#ifdef  G711_AVX2
+
+typedef struct {
+    int dqlntab[32], witab[32], fitab[32], qtab[15];
+    int qsize, sign, mask, decay;
+    bool wide, fixup;
+}   g726_avx2_t;
+
+static void g726_context(const g726_profile_t *p, g726_avx2_t *ctx)
 {
-    unsigned count = (lsamples / 8);
-    Encoded dest = (Encoded)coded;
-    unsigned i, data, byte, bits;
+    unsigned pos;
 
-    while(count--) {
-        bits = 0;
-        data = 0;
-        for(i = 0; i < 8; ++i)
-        {
-            byte = encoder(*(buffer++), &encode_state);
-            data |= (byte << bits);
-            bits += 5;
-            if(bits >= 8) {
-                *(dest++) = (data & 0xff);
-                bits -= 8;
-                data >>= 8;
-            }
-        }
+    memset(ctx, 0, sizeof(g726_avx2_t));
+    for(pos = 0; pos < (1u << p->bits); ++pos) {
+        ctx->dqlntab[pos] = p->dqlntab[pos];
+        ctx->witab[pos] = p->witab[pos] << p->wshift;
+        ctx->fitab[pos] = p->fitab[pos];
     }
-    return (lsamples / 8) * 8;
+
+    for(pos = 0; pos < (unsigned)p->qsize; ++pos)
+        ctx->qtab[pos] = p->qtab[pos];
+
+    ctx->qsize = p->qsize;
+    ctx->sign = p->sign;
+    ctx->mask = p->mask;
+    ctx->decay = (p->bits == 5) ? 9 : 8;
+    ctx->wide = p->wide;
+    ctx->fixup = (p->bits == 2);
 }
 
-unsigned g723_5Codec::decode(Linear buffer, void *from, unsigned lsamples)
+static inline G711_AVX2_TARGET __m256i g726_get_avx2(const int *field)
 {
-    Encoded src = (Encoded)from;
-    unsigned count = (lsamples / 8) * 8;
-    unsigned char byte, nib;
-    unsigned bits = 0, data = 0;
+    return _mm256_loadu_si256((const __m256i *)field);
+}
 
-    while(count--) {
-        if(bits < 5) {
-            byte = *(src++);
-            data |= (byte << bits);
-            bits += 8;
-        }
-        nib = data & 0x1f;
-        data >>= 5;
-        bits -= 5;
-        *(buffer++) = coder(&decode_state, nib);
-    }
-    return (lsamples / 8) * 8;
+static inline G711_AVX2_TARGET void g726_put_avx2(int *field, __m256i value)
+{
+    _mm256_storeu_si256((__m256i *)field, value);
 }
 
-AudioCodec *g723_5Codec::getByInfo(Info &info)
+static inline G711_AVX2_TARGET __m256i g726_short_avx2(__m256i x)
 {
-    return (AudioCodec *)new g723_5Codec();
+    return _mm256_srai_epi32(_mm256_slli_epi32(x, 16), 16);
 }
 
-AudioCodec *g723_5Codec::getByFormat(const char *format)
+static inline G711_AVX2_TARGET __m256i g726_int_avx2(int value)
 {
-    return (AudioCodec *)new g723_5Codec();
+    return _mm256_set1_epi32(value);
 }
 
-g721Codec::g721Codec() : AudioCodec()
+// quan() against power2[]: the bit length of a positive value, limit 15
+static inline G711_AVX2_TARGET __m256i g726_quan_avx2(__m256i x)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i e = _mm256_castps_si256(_mm256_cvtepi32_ps(_mm256_max_epi32(x, zero)));
+
+    e = _mm256_sub_epi32(_mm256_srli_epi32(e, 23), g726_int_avx2(126));
+    return _mm256_min_epi32(_mm256_max_epi32(e, zero), g726_int_avx2(15));
+}
+
+static inline G711_AVX2_TARGET __m256i g726_fmult_avx2(__m256i an, __m256i srn)
 {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i anmag, anexp, anmant, wanexp, wanmant, retval, sign;
+
+    anmag = g711_select_avx2(_mm256_cmpgt_epi32(an, zero), an,
+        _mm256_and_si256(_mm256_sub_epi32(zero, an), g726_int_avx2(0x1fff)));
+    anexp = _mm256_sub_epi32(g726_quan_avx2(anmag), g726_int_avx2(6));
+    anmant = g711_select_avx2(_mm256_cmpgt_epi32(zero, anexp),
+        _mm256_sllv_epi32(anmag, _mm256_sub_epi32(zero, anexp)),
+        _mm256_srlv_epi32(anmag, anexp));
+    anmant = g711_select_avx2(_mm256_cmpeq_epi32(anmag, zero), g726_int_avx2(32), anmant);
+
+    wanexp = _mm256_and_si256(_mm256_srai_epi32(srn, 6), g726_int_avx2(0xf));
+    wanexp = _mm256_sub_epi32(_mm256_add_epi32(anexp, wanexp), g726_int_avx2(13));
+
+    // both factors are below 64, so a 16 bit multiply is exact
+    wanmant = _mm256_mullo_epi16(anmant, _mm256_and_si256(srn, g726_int_avx2(077)));
+    wanmant = _mm256_srli_epi32(_mm256_add_epi32(wanmant, g726_int_avx2(0x30)), 4);
+
+    retval = g711_select_avx2(_mm256_cmpgt_epi32(zero, wanexp),
+        _mm256_srlv_epi32(wanmant, _mm256_sub_epi32(zero, wanexp)),
+        _mm256_and_si256(_mm256_sllv_epi32(wanmant, wanexp), g726_int_avx2(0x7fff)));
+
+    sign = _mm256_srai_epi32(_mm256_xor_si256(an, srn), 31);
+    return _mm256_sub_epi32(_mm256_xor_si256(retval, sign), sign);
+}
+
+// float a value into the 4 bit exponent, 6 bit mantissa form of dq/sr
+static inline G711_AVX2_TARGET __m256i g726_float_avx2(__m256i mag, __m256i negative)
+{
+    __m256i exp = g726_quan_avx2(mag);
+    __m256i value = _mm256_add_epi32(_mm256_slli_epi32(exp, 6),
+        _mm256_srlv_epi32(_mm256_slli_epi32(mag, 6), exp));
+
+    return g726_short_avx2(_mm256_sub_epi32(value, _mm256_and_si256(negative, g726_int_avx2(0x400))));
+}
+
+static inline G711_AVX2_TARGET void g726_update_avx2(const g726_avx2_t *ctx, g726_lanes_t *s, __m256i y, __m256i wi, __m256i fi, __m256i dq, __m256i sr, __m256i dqsez)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i pk0, pk1, mag, yl, ylint, thr, dqthr, tr, yu, pks1, nz, flip;
+    __m256i a0, a1, a2p, fa1, adj, lo, hi, lim, a1ul, td, dms, dml, ap, cond, b, dqk;
     unsigned pos;
 
-    info.framesize = 1;
-    info.framecount = 2;
-    info.rate = 8000;
-    info.bitrate = 32000;
-    info.annotation = (char *)"g.721";
-    info.encoding = g721ADPCM;
+    pk0 = _mm256_srli_epi32(dqsez, 31);
+    pk1 = g726_get_avx2(s->pk[0]);
+    mag = _mm256_and_si256(dq, g726_int_avx2(0x7fff));
+
+    // TRANS
+    yl = g726_get_avx2(s->yl);
+    ylint = _mm256_srai_epi32(yl, 15);
+    thr = _mm256_add_epi32(_mm256_and_si256(_mm256_srai_epi32(yl, 10), g726_int_avx2(0x1f)), g726_int_avx2(32));
+    thr = g726_short_avx2(_mm256_sllv_epi32(thr, ylint));
+    thr = g711_select_avx2(_mm256_cmpgt_epi32(ylint, g726_int_avx2(9)), g726_int_avx2(31 << 10), thr);
+    dqthr = g726_short_avx2(_mm256_srai_epi32(_mm256_add_epi32(thr, _mm256_srai_epi32(thr, 1)), 1));
+    tr = _mm256_andnot_si256(_mm256_cmpeq_epi32(g726_get_avx2(s->td), zero), _mm256_cmpgt_epi32(mag, dqthr));
+
+    // FUNCTW, FILTD, LIMB, FILTE
+    yu = g726_short_avx2(_mm256_add_epi32(y, _mm256_srai_epi32(_mm256_sub_epi32(wi, y), 5)));
+    yu = _mm256_min_epi32(_mm256_max_epi32(yu, g726_int_avx2(544)), g726_int_avx2(5120));
+    g726_put_avx2(s->yu, yu);
+    yl = _mm256_add_epi32(yl, _mm256_add_epi32(yu, _mm256_srai_epi32(_mm256_sub_epi32(zero, yl), 6)));
+    g726_put_avx2(s->yl, yl);
+
+    // UPA2
+    pks1 = _mm256_cmpeq_epi32(_mm256_xor_si256(pk0, pk1), g726_int_avx2(1));
+    nz = _mm256_xor_si256(_mm256_cmpeq_epi32(dqsez, zero), _mm256_cmpeq_epi32(zero, zero));
+    a0 = g726_get_avx2(s->a[0]);
+    a1 = g726_get_avx2(s->a[1]);
+    a2p = g726_short_avx2(_mm256_sub_epi32(a1, _mm256_srai_epi32(a1, 7)));
+    fa1 = g726_short_avx2(g711_select_avx2(pks1, a0, _mm256_sub_epi32(zero, a0)));
+    adj = _mm256_srai_epi32(fa1, 5);
+    adj = g711_select_avx2(_mm256_cmpgt_epi32(fa1, g726_int_avx2(8191)), g726_int_avx2(0xff), adj);
+    adj = g711_select_avx2(_mm256_cmpgt_epi32(g726_int_avx2(-8191), fa1), g726_int_avx2(-0x100), adj);
+    fa1 = g726_short_avx2(_mm256_add_epi32(a2p, adj));
+
+    // LIMC
+    flip = _mm256_cmpeq_epi32(_mm256_xor_si256(pk0, g726_get_avx2(s->pk[1])), g726_int_avx2(1));
+    lo = g711_select_avx2(flip, g726_int_avx2(-12160), g726_int_avx2(-12416));
+    hi = g711_select_avx2(flip, g726_int_avx2(12416), g726_int_avx2(12160));
+    lim = g726_short_avx2(_mm256_add_epi32(fa1, g711_select_avx2(flip, g726_int_avx2(-0x80), g726_int_avx2(0x80))));
+    lim = g711_select_avx2(_mm256_cmpgt_epi32(fa1, lo), lim, g726_int_avx2(-12288));
+    lim = g711_select_avx2(_mm256_cmpgt_epi32(hi, fa1), lim, g726_int_avx2(12288));
+    a2p = g711_select_avx2(nz, lim, a2p);
+
+    // UPA1, LIMD
+    a0 = g726_short_avx2(_mm256_sub_epi32(a0, _mm256_srai_epi32(a0, 8)));
+    adj = g711_select_avx2(pks1, g726_int_avx2(-192), g726_int_avx2(192));
+    a0 = g726_short_avx2(_mm256_add_epi32(a0, _mm256_and_si256(nz, adj)));
+    a1ul = g726_short_avx2(_mm256_sub_epi32(g726_int_avx2(15360), a2p));
+    a0 = _mm256_min_epi32(_mm256_max_epi32(a0, _mm256_sub_epi32(zero, a1ul)), a1ul);
+
+    a2p = _mm256_andnot_si256(tr, a2p);
+    g726_put_avx2(s->a[0], _mm256_andnot_si256(tr, a0));
+    g726_put_avx2(s->a[1], a2p);
+
+    // UPB, then DELAY of dq
+    nz = _mm256_xor_si256(_mm256_cmpeq_epi32(mag, zero), _mm256_cmpeq_epi32(zero, zero));
+    for(pos = 0; pos < 6; ++pos) {
+        b = g726_get_avx2(s->b[pos]);
+        dqk = g726_get_avx2(s->dq[pos]);
+        b = g726_short_avx2(_mm256_sub_epi32(b, _mm256_sra_epi32(b, _mm_cvtsi32_si128(ctx->decay))));
+        adj = g711_select_avx2(_mm256_cmpgt_epi32(zero, _mm256_xor_si256(dq, dqk)), g726_int_avx2(-128), g726_int_avx2(128));
+        b = g726_short_avx2(_mm256_add_epi32(b, _mm256_and_si256(nz, adj)));
+        g726_put_avx2(s->b[pos], _mm256_andnot_si256(tr, b));
+    }
 
-    memset(&encode_state, 0, sizeof(encode_state));
-    memset(&decode_state, 0, sizeof(decode_state));
-    encode_state.yl = decode_state.yl = 34816;
-    encode_state.yu = decode_state.yu = 544;
-    encode_state.sr[0] = encode_state.sr[1] = decode_state.sr[0] = decode_state.sr[1] = 32;
+    for(pos = 5; pos > 0; --pos)
+        g726_put_avx2(s->dq[pos], g726_get_avx2(s->dq[pos - 1]));
+
+    // FLOAT A
+    cond = _mm256_cmpgt_epi32(zero, dq);
+    dqk = g726_float_avx2(mag, cond);
+    dqk = g711_select_avx2(_mm256_cmpeq_epi32(mag, zero),
+        g711_select_avx2(cond, g726_int_avx2((short)0xfc20), g726_int_avx2(0x20)), dqk);
+    g726_put_avx2(s->dq[0], dqk);
+
+    // FLOAT B
+    g726_put_avx2(s->sr[1], g726_get_avx2(s->sr[0]));
+    cond = _mm256_cmpgt_epi32(zero, sr);
+    dqk = g726_float_avx2(_mm256_abs_epi32(sr), cond);
+    dqk = g711_select_avx2(_mm256_cmpeq_epi32(sr, zero), g726_int_avx2(0x20), dqk);
+    dqk = g711_select_avx2(_mm256_cmpeq_epi32(sr, g726_int_avx2(-32768)), g726_int_avx2((short)0xfc20), dqk);
+    g726_put_avx2(s->sr[0], dqk);
+
+    // DELAY A
+    g726_put_avx2(s->pk[1], pk1);
+    g726_put_avx2(s->pk[0], pk0);
+
+    // TONE
+    td = _mm256_andnot_si256(tr, _mm256_cmpgt_epi32(g726_int_avx2(-11776), a2p));
+    g726_put_avx2(s->td, _mm256_srli_epi32(td, 31));
+
+    // FILTA, FILTB, SUBTC
+    dms = g726_get_avx2(s->dms);
+    dml = g726_get_avx2(s->dml);
+    dms = g726_short_avx2(_mm256_add_epi32(dms, _mm256_srai_epi32(_mm256_sub_epi32(fi, dms), 5)));
+    dml = g726_short_avx2(_mm256_add_epi32(dml, _mm256_srai_epi32(_mm256_sub_epi32(_mm256_slli_epi32(fi, 2), dml), 7)));
+    g726_put_avx2(s->dms, dms);
+    g726_put_avx2(s->dml, dml);
+
+    cond = _mm256_abs_epi32(_mm256_sub_epi32(_mm256_slli_epi32(dms, 2), dml));
+    cond = _mm256_xor_si256(_mm256_cmpgt_epi32(_mm256_srai_epi32(dml, 3), cond), _mm256_cmpeq_epi32(zero, zero));
+    cond = _mm256_or_si256(cond, _mm256_or_si256(td, _mm256_cmpgt_epi32(g726_int_avx2(1536), y)));
+    ap = g726_get_avx2(s->ap);
+    ap = g711_select_avx2(cond, _mm256_add_epi32(ap, _mm256_srai_epi32(_mm256_sub_epi32(g726_int_avx2(0x200), ap), 4)),
+        _mm256_add_epi32(ap, _mm256_srai_epi32(_mm256_sub_epi32(zero, ap), 4)));
+    ap = g711_select_avx2(tr, g726_int_avx2(256), g726_short_avx2(ap));
+    g726_put_avx2(s->ap, ap);
+}
+
+// one sample for every lane of a group: in holds the input samples when
+// encoding or the codes when decoding, and the codes or decoded samples
+// are returned.
+
+static inline G711_AVX2_TARGET __m256i g726_step_avx2(const g726_avx2_t *ctx, g726_lanes_t *s, __m256i in, bool encode)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i sezi, sez, sei, se, yl, yu, ap, y, dif, d, dqm, exp, dln, i, sign, dql, dq, sr, dqsez;
+    unsigned pos;
 
+    sezi = zero;
     for(pos = 0; pos < 6; ++pos)
-        encode_state.dq[pos] = decode_state.dq[pos] = 32;
+        sezi = _mm256_add_epi32(sezi, g726_fmult_avx2(_mm256_srai_epi32(g726_get_avx2(s->b[pos]), 2), g726_get_avx2(s->dq[pos])));
+    sezi = g726_short_avx2(sezi);
+    sez = _mm256_srai_epi32(sezi, 1);
+    sei = _mm256_add_epi32(sezi, _mm256_add_epi32(
+        g726_fmult_avx2(_mm256_srai_epi32(g726_get_avx2(s->a[1]), 2), g726_get_avx2(s->sr[1])),
+        g726_fmult_avx2(_mm256_srai_epi32(g726_get_avx2(s->a[0]), 2), g726_get_avx2(s->sr[0]))));
+    if(encode && ctx->wide)
+        se = g726_short_avx2(_mm256_srai_epi32(sei, 1));
+    else
+        se = _mm256_srai_epi32(g726_short_avx2(sei), 1);
+
+    // step_size()
+    yl = g726_get_avx2(s->yl);
+    yu = g726_get_avx2(s->yu);
+    ap = g726_get_avx2(s->ap);
+    y = _mm256_srai_epi32(yl, 6);
+    dif = _mm256_sub_epi32(yu, y);
+    dif = _mm256_add_epi32(_mm256_mullo_epi32(dif, _mm256_srai_epi32(ap, 2)),
+        _mm256_and_si256(_mm256_cmpgt_epi32(zero, dif), g726_int_avx2(0x3f)));
+    y = _mm256_add_epi32(y, _mm256_srai_epi32(dif, 6));
+    y = g726_short_avx2(g711_select_avx2(_mm256_cmpgt_epi32(ap, g726_int_avx2(255)), yu, y));
+
+    if(encode) {
+        d = g726_short_avx2(_mm256_sub_epi32(_mm256_srai_epi32(in, 2), se));
+
+        // quantize()
+        dqm = g726_short_avx2(_mm256_abs_epi32(d));
+        exp = g726_quan_avx2(_mm256_srai_epi32(dqm, 1));
+        dln = _mm256_and_si256(_mm256_srav_epi32(_mm256_slli_epi32(dqm, 7), exp), g726_int_avx2(0x7f));
+        dln = g726_short_avx2(_mm256_add_epi32(_mm256_slli_epi32(exp, 7), dln));
+        dln = g726_short_avx2(_mm256_sub_epi32(dln, _mm256_srai_epi32(y, 2)));
+
+        i = g726_int_avx2(ctx->qsize);
+        for(pos = 0; pos < (unsigned)ctx->qsize; ++pos)
+            i = _mm256_add_epi32(i, _mm256_cmpgt_epi32(g726_int_avx2(ctx->qtab[pos]), dln));
+
+        dif = g726_int_avx2((ctx->qsize << 1) + 1);
+        i = g711_select_avx2(_mm256_cmpgt_epi32(zero, d), _mm256_sub_epi32(dif, i),
+            g711_select_avx2(_mm256_cmpeq_epi32(i, zero), dif, i));
+
+        if(ctx->fixup)
+            i = _mm256_andnot_si256(_mm256_and_si256(_mm256_cmpeq_epi32(i, g726_int_avx2(3)),
+                _mm256_cmpeq_epi32(_mm256_and_si256(d, g726_int_avx2(0x8000)), zero)), i);
+    }
+    else
+        i = in;
+
+    // reconstruct()
+    sign = g726_int_avx2(ctx->sign);
+    sign = _mm256_cmpeq_epi32(_mm256_and_si256(i, sign), sign);
+    dql = _mm256_i32gather_epi32(ctx->dqlntab, i, 4);
+    dql = g726_short_avx2(_mm256_add_epi32(dql, _mm256_srai_epi32(y, 2)));
+    dq = _mm256_add_epi32(_mm256_and_si256(dql, g726_int_avx2(127)), g726_int_avx2(128));
+    dq = _mm256_srlv_epi32(_mm256_slli_epi32(dq, 7),
+        _mm256_sub_epi32(g726_int_avx2(14), _mm256_and_si256(_mm256_srai_epi32(dql, 7), g726_int_avx2(15))));
+    dq = g726_short_avx2(dq);
+    dq = g711_select_avx2(sign, _mm256_sub_epi32(dq, g726_int_avx2(0x8000)), dq);
+    dq = g711_select_avx2(_mm256_cmpgt_epi32(zero, dql), _mm256_and_si256(sign, g726_int_avx2(-0x8000)), dq);
+
+    sr = g711_select_avx2(_mm256_cmpgt_epi32(zero, dq),
+        _mm256_sub_epi32(se, _mm256_and_si256(dq, g726_int_avx2(ctx->mask))), _mm256_add_epi32(se, dq));
+    sr = g726_short_avx2(sr);
+    dqsez = g726_short_avx2(_mm256_sub_epi32(_mm256_add_epi32(sr, sez), se));
+
+    g726_update_avx2(ctx, s, y, _mm256_i32gather_epi32(ctx->witab, i, 4),
+        _mm256_i32gather_epi32(ctx->fitab, i, 4), dq, sr, dqsez);
+
+    if(encode)
+        return i;
+    return g726_short_avx2(_mm256_slli_epi32(sr, 2));
 }
 
-g721Codec::g721Codec(const char *id, Encoding e) : AudioCodec(id, e)
+static G711_AVX2_TARGET void g726_encode_avx2(const g726_profile_t *p, g726_lanes_t *lanes, Audio::Linear *buffers, Audio::Encoded *coded, unsigned count, unsigned samples)
 {
-    info.framesize = 1;
-    info.framecount = 2;
-    info.rate = 8000;
-    info.bitrate = 32000;
-    info.annotation = (char *)"g.721";
-}
+    g726_avx2_t ctx;
+    Audio::Encoded dest[G726_LANES];
+    unsigned data[G726_LANES], bits[G726_LANES];
+    int in[G726_LANES], code[G726_LANES];
+    unsigned lane, pos;
+
+    g726_context(p, &ctx);
+    memset(in, 0, sizeof(in));
+    for(lane = 0; lane < count; ++lane) {
+        dest[lane] = coded[lane];
+        data[lane] = bits[lane] = 0;
+    }
 
-g721Codec::~g721Codec()
-{}
+    for(pos = 0; pos < samples; ++pos) {
+        for(lane = 0; lane < count; ++lane)
+            in[lane] = buffers[lane][pos];
 
-unsigned char g721Codec::encoder(short sl, state_t *state)
+        g726_put_avx2(code, g726_step_avx2(&ctx, lanes, g726_get_avx2(in), true));
+
+        for(lane = 0; lane < count; ++lane) {
+            data[lane] |= code[lane] << bits[lane];
+            bits[lane] += p->bits;
+            if(bits[lane] >= 8) {
+                *(dest[lane]++) = (data[lane] & 0xff);
+                bits[lane] -= 8;
+                data[lane] >>= 8;
+            }
+        }
+    }
+}
+
+static G711_AVX2_TARGET void g726_decode_avx2(const g726_profile_t *p, g726_lanes_t *lanes, Audio::Linear *buffers, Audio::Encoded *coded, unsigned count, unsigned samples)
 {
-    short sezi, se, sez;
-    short d, sr, y, dqsez, dq, i;
+    g726_avx2_t ctx;
+    Audio::Encoded src[G726_LANES];
+    unsigned data[G726_LANES], bits[G726_LANES];
+    int in[G726_LANES], out[G726_LANES];
+    unsigned lane, pos, mask = (1u << p->bits) - 1;
+
+    g726_context(p, &ctx);
+    memset(in, 0, sizeof(in));
+    for(lane = 0; lane < count; ++lane) {
+        src[lane] = coded[lane];
+        data[lane] = bits[lane] = 0;
+    }
 
-    sl >>= 2;
+    for(pos = 0; pos < samples; ++pos) {
+        for(lane = 0; lane < count; ++lane) {
+            if(bits[lane] < p->bits) {
+                data[lane] |= *(src[lane]++) << bits[lane];
+                bits[lane] += 8;
+            }
+            in[lane] = data[lane] & mask;
+            data[lane] >>= p->bits;
+            bits[lane] -= p->bits;
+        }
 
-    sezi = predictor_zero(state);
-    sez = sezi >> 1;
-    se = (sezi + predictor_pole(state)) >> 1;
+        g726_put_avx2(out, g726_step_avx2(&ctx, lanes, g726_get_avx2(in), false));
 
-    d = sl - se;
+        for(lane = 0; lane < count; ++lane)
+            buffers[lane][pos] = (Audio::Sample)out[lane];
+    }
+}
 
-    y = step_size(state);
-    i = quantize(d, y, qtab_721, 7);
-    dq = reconstruct(i & 8, _dqlntab[i], y);
-    sr = (dq < 0) ? se - (dq & 0x3FFF) : se + dq;
+#endif
 
-    dqsez = sr + sez - se;
+static class __LOCAL g726select
+{
+public:
+    g726select();
+} g726_select;
 
-    update(4, y, _witab[i] << 5, _fitab[i], dq, sr, dqsez, state);
+g726select::g726select()
+{
+#ifdef  G726_BMI2
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("bmi2")) {
+        g726_packer = &g726_pack_bmi2;
+        g726_unpacker = &g726_unpack_bmi2;
+    }
+#endif
 
-    return (unsigned char)(i);
+#ifdef  G711_AVX2
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) {
+        g726_encode_kernel = &g726_encode_avx2;
+        g726_decode_kernel = &g726_decode_avx2;
+    }
+#endif
 }
 
-short g721Codec::coder(state_t *state, int i)
+void AudioADPCMBank::setEngine(AudioCodec::Engine mode)
 {
-    short sezi, sei, sez, se;
-    short y, sr, dq, dqsez;
+#ifdef  __GNUC__
+    __atomic_store_n(&g726_scalar, mode == AudioCodec::engineScalar, __ATOMIC_RELAXED);
+#else
+    g726_scalar = (mode == AudioCodec::engineScalar);
+#endif
+}
 
-    sezi = predictor_zero(state);
-    sez = sezi >> 1;
-    sei = sezi + predictor_pole(state);
-    se = sei >> 1;
-    y = step_size(state);
-    dq = reconstruct(i & 0x08, _dqlntab[i], y);
-    sr = (dq < 0) ? (se - (dq & 0x3fff)) : se + dq;
-    dqsez = sr - se + sez;
-    update(4, y, _witab[i] << 5, _fitab[i], dq, sr, dqsez, state);
-    return sr << 2;
+AudioCodec::Engine AudioADPCMBank::getEngine(void)
+{
+    return G726_SCALAR ? AudioCodec::engineScalar : AudioCodec::engineAuto;
 }
 
-unsigned g721Codec::encode(Linear buffer, void *coded, unsigned lsamples)
+AudioADPCMBank::AudioADPCMBank(Encoding encoding, unsigned count)
 {
-    unsigned count = (lsamples / 2);
-    unsigned char byte = 0;
-    Encoded dest = (Encoded)coded;
-    unsigned data, bits, i;
+    unsigned groups = (count + G726_LANES - 1) / G726_LANES;
 
-    while(count--) {
-        bits = 0;
-        data = 0;
-        for(i = 0; i < 2; ++i)
-        {
-            byte = encoder(*(buffer++), &encode_state);
-            data |= (byte << bits);
-            bits += 4;
-            if(bits >= 8)
-                *(dest++) = (data & 0xff);
-        }
+    switch(encoding) {
+    case g721ADPCM:
+        profile = &g721Codec::profile;
+        break;
+    case g723_2bit:
+        profile = &g723_2Codec::profile;
+        break;
+    case g723_3bit:
+        profile = &g723_3Codec::profile;
+        break;
+    case g723_5bit:
+        profile = &g723_5Codec::profile;
+        break;
+    default:
+        profile = NULL;
+        count = groups = 0;
     }
-    return (lsamples / 2) * 2;
+
+    channels = count;
+    encode_lanes = decode_lanes = NULL;
+    if(groups) {
+        encode_lanes = new g726_lanes_t[groups];
+        decode_lanes = new g726_lanes_t[groups];
+    }
+    reset();
 }
 
-unsigned g721Codec::decode(Linear buffer, void *from, unsigned lsamples)
+AudioADPCMBank::~AudioADPCMBank()
 {
-    Encoded src = (Encoded)from;
-    unsigned count = lsamples / 2;
-    unsigned data;
+    if(encode_lanes)
+        delete[] (g726_lanes_t *)encode_lanes;
+    if(decode_lanes)
+        delete[] (g726_lanes_t *)decode_lanes;
+}
 
-    while(count--) {
-        data = *(src++);
-        *(buffer++) = coder(&decode_state, (data & 0x0f));
-        data >>= 4;
-        *(buffer++) = coder(&decode_state, (data & 0x0f));
+void AudioADPCMBank::reset(unsigned channel)
+{
+    state_t state;
+
+    if(channel >= channels)
+        return;
+
+    init_state(&state);
+    g726_store(&((g726_lanes_t *)encode_lanes)[channel / G726_LANES], channel % G726_LANES, &state);
+    g726_store(&((g726_lanes_t *)decode_lanes)[channel / G726_LANES], channel % G726_LANES, &state);
+}
+
+void AudioADPCMBank::reset(void)
+{
+    unsigned groups = (channels + G726_LANES - 1) / G726_LANES;
+    unsigned channel;
+
+    for(channel = 0; channel < groups * G726_LANES; ++channel) {
+        state_t state;
+
+        init_state(&state);
+        g726_store(&((g726_lanes_t *)encode_lanes)[channel / G726_LANES], channel % G726_LANES, &state);
+        g726_store(&((g726_lanes_t *)decode_lanes)[channel / G726_LANES], channel % G726_LANES, &state);
     }
-    return (lsamples / 2) * 2;
 }
 
-AudioCodec *g721Codec::getByInfo(Info &info)
+unsigned AudioADPCMBank::encode(Linear *buffers, Encoded *coded, unsigned samples)
 {
-    return (AudioCodec *)new g721Codec();
+    const g726_profile_t *p = (const g726_profile_t *)profile;
+    g726_lanes_t *lanes = (g726_lanes_t *)encode_lanes;
+    g726coder_t encoder = G726_SCALAR ? NULL : g726_encode_kernel;
+    unsigned channel, count, lane, pos, data, bits;
+    state_t state;
+    Encoded dest;
+
+    if(!p)
+        return 0;
+
+    samples -= samples % p->frame;
+    for(channel = 0; channel < channels; channel += G726_LANES) {
+        count = channels - channel;
+        if(count > G726_LANES)
+            count = G726_LANES;
+
+        if(encoder) {
+            encoder(p, lanes, &buffers[channel], &coded[channel], count, samples);
+            ++lanes;
+            continue;
+        }
+
+        for(lane = 0; lane < count; ++lane) {
+            g726_load(lanes, lane, &state);
+            dest = coded[channel + lane];
+            data = bits = 0;
+            for(pos = 0; pos < samples; ++pos) {
+                data |= g726_encoder(p, buffers[channel + lane][pos], &state) << bits;
+                bits += p->bits;
+                if(bits >= 8) {
+                    *(dest++) = (data & 0xff);
+                    bits -= 8;
+                    data >>= 8;
+                }
+            }
+            g726_store(lanes, lane, &state);
+        }
+        ++lanes;
+    }
+    return samples;
 }
 
-AudioCodec *g721Codec::getByFormat(const char *format)
+unsigned AudioADPCMBank::decode(Linear *buffers, Encoded *coded, unsigned samples)
 {
-    return (AudioCodec *)new g721Codec();
+    const g726_profile_t *p = (const g726_profile_t *)profile;
+    g726_lanes_t *lanes = (g726_lanes_t *)decode_lanes;
+    g726coder_t decoder = G726_SCALAR ? NULL : g726_decode_kernel;
+    unsigned channel, count, lane, pos, data, bits, mask;
+    state_t state;
+    Encoded src;
+
+    if(!p)
+        return 0;
+
+    mask = (1u << p->bits) - 1;
+    samples -= samples % p->frame;
+    for(channel = 0; channel < channels; channel += G726_LANES) {
+        count = channels - channel;
+        if(count > G726_LANES)
+            count = G726_LANES;
+
+        if(decoder) {
+            decoder(p, lanes, &buffers[channel], &coded[channel], count, samples);
+            ++lanes;
+            continue;
+        }
+
+        for(lane = 0; lane < count; ++lane) {
+            g726_load(lanes, lane, &state);
+            src = coded[channel + lane];
+            data = bits = 0;
+            for(pos = 0; pos < samples; ++pos) {
+                if(bits < p->bits) {
+                    data |= *(src++) << bits;
+                    bits += 8;
+                }
+                buffers[channel + lane][pos] = g726_coder(p, data & mask, &state);
+                data >>= p->bits;
+                bits -= p->bits;
+            }
+            g726_store(lanes, lane, &state);
+        }
+        ++lanes;
+    }
+    return samples;
 }
 
 static int oki_index[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
@@ -1580,25 +3676,103 @@ static int oki_steps[49] = {
     1060, 1166, 1282, 1411, 1552
 };
 
+// oki/vox table engine.  Each entry holds the difference a code adds at
+// a step index and the table row of the index that follows, so decoding
+// a sample is one load, an add and a clamp, with no branches on the code.
+
+typedef struct {
+    short diff;
+    short next;
+}   oki_entry_t;
+
+static oki_entry_t oki_table[49 * 16];
+
+static class __LOCAL okitable
+{
+public:
+    okitable();
+} oki_tables;
+
+okitable::okitable()
+{
+    unsigned index, code;
+    short diff, step;
+    int next;
+
+    for(index = 0; index < 49; ++index) {
+        step = oki_steps[index];
+        for(code = 0; code < 16; ++code) {
+            diff = step / 8;
+            if(code & 0x01)
+                diff += step / 4;
+            if(code & 0x02)
+                diff += step / 2;
+            if(code & 0x04)
+                diff += step;
+            if(code & 0x08)
+                diff = -diff;
+
+            next = index + oki_index[code & 0x07];
+            if(next < 0)
+                next = 0;
+            else if(next > 48)
+                next = 48;
+
+            oki_table[index * 16 + code].diff = diff;
+            oki_table[index * 16 + code].next = (short)(next * 16);
+        }
+    }
+}
+
+static inline int oki_decode(int last, unsigned& row, unsigned code)
+{
+    const oki_entry_t *entry = &oki_table[row + code];
+    int sample = last + entry->diff;
+
+    sample = (sample > 2047) ? 2047 : sample;
+    sample = (sample < -2047) ? -2047 : sample;
+    row = entry->next;
+    return sample;
+}
+
+static inline unsigned oki_encode(int& last, unsigned& row, int sample)
+{
+    int step = oki_steps[row / 16];
+    int diff = sample - last;
+    unsigned code = (diff < 0) ? 0x08 : 0;
+    int mask;
+
+    diff = abs(diff);
+    mask = -(diff >= step);
+    code |= 0x04 & mask;
+    diff -= step & mask;
+    mask = -(diff >= step / 2);
+    code |= 0x02 & mask;
+    diff -= (step / 2) & mask;
+    code |= (diff >= step / 4);
+
+    last = oki_decode(last, row, code);
+    return code;
+}
+
 static class __LOCAL okiCodec : private AudioCodec
 {
 private:
     __DELETE_COPY(okiCodec);
 
     typedef struct state {
-        short last;
-        short ssindex;
+        int last;
+        unsigned row;
     }   state_t;
 
     state_t encode_state, decode_state;
 
+    bool reset(void) __FINAL;
     AudioCodec *getByInfo(Info &info) __FINAL;
     AudioCodec *getByFormat(const char *format) __FINAL;
 
     unsigned decode(Linear buffer, void *from, unsigned lsamples) __FINAL;
     unsigned encode(Linear buffer, void *dest, unsigned lsamples) __FINAL;
-    unsigned char encode_sample(state_t *state, short sample);
-    short decode_sample(state_t *state, unsigned char code);
 
 public:
     okiCodec(const char *id, Encoding e);
@@ -1612,7 +3786,7 @@ okiCodec::okiCodec(Encoding e) : AudioCodec()
     info.framecount = 2;
     info.encoding = e;
 
-    if(encoding == voxADPCM) {
+    if(e == voxADPCM) {
         info.rate = 6000;
         info.bitrate = 24000;
         info.annotation = (char *)"vox";
@@ -1651,76 +3825,29 @@ okiCodec::okiCodec(const char *id, Encoding e) : AudioCodec(id, e)
 okiCodec::~okiCodec()
 {}
 
-unsigned char okiCodec::encode_sample(state_t *state, short sample)
+bool okiCodec::reset(void)
 {
-    unsigned char code = 0;
-    short diff, step;
-
-    step = oki_steps[state->ssindex];
-    diff = sample - state->last;
-    if(diff < 0) {
-        diff = -diff;
-        code = 0x08;
-    }
-
-    if(diff >= step) {
-        code |= 0x04;
-        diff -= step;
-    }
-    if(diff >= step/2) {
-        code |= 0x02;
-        diff -= step/2;
-    }
-    if(diff >= step/4)
-        code |= 0x01;
-
-    decode_sample(state, code);
-    return code;
-}
-
-short okiCodec::decode_sample(state_t *state, unsigned char code)
-{
-    short diff, step, sample;
-
-    step = oki_steps[state->ssindex];
-    diff = step / 8;
-    if(code & 0x01)
-        diff += step / 4;
-    if(code & 0x02)
-        diff += step / 2;
-    if(code & 0x04)
-        diff += step;
-    if(code & 0x08)
-        diff = -diff;
-    sample = state->last + diff;
-    if(sample > 2047)
-        sample = 2047;
-    else if(sample < -2047)
-        sample = -2047;
-    state->last = sample;
-    state->ssindex += oki_index[code & 0x07];
-    if(state->ssindex < 0)
-        state->ssindex = 0;
-    if(state->ssindex > 48)
-        state->ssindex = 48;
-    return sample;
+    memset(&encode_state, 0, sizeof(encode_state));
+    memset(&decode_state, 0, sizeof(decode_state));
+    return true;
 }
 
 unsigned okiCodec::encode(Linear buffer, void *coded, unsigned lsamples)
 {
-    unsigned count = (lsamples / 2) * 2;
-    bool hi = false;
-    unsigned char byte = 0;
+    unsigned count = lsamples / 2;
     Encoded dest = (Encoded)coded;
+    int last = encode_state.last;
+    unsigned row = encode_state.row;
+    unsigned char byte;
 
     while(count--) {
-        if(hi) {
-            byte |= encode_sample(&encode_state, *(buffer++) / 16 );
-            *(dest++) = byte;
-        }
-        else
-            byte = encode_sample(&encode_state, *(buffer++) / 16 ) << 4 ;
+        byte = oki_encode(last, row, *(buffer++) / 16) << 4;
+        byte |= oki_encode(last, row, *(buffer++) / 16);
+        *(dest++) = byte;
     }
+
+    encode_state.last = last;
+    encode_state.row = row;
     return (lsamples / 2) * 2;
 }
 
@@ -1728,26 +3855,38 @@ unsigned okiCodec::decode(Linear buffer, void *from, unsigned lsamples)
 {
     Encoded src = (Encoded)from;
     unsigned count = lsamples / 2;
-    unsigned char byte;
+    int last = decode_state.last;
+    unsigned row = decode_state.row;
 
     while(count--) {
-        byte = ((*src >> 4) & 0x0f);
-        *(buffer++) = (decode_sample(&decode_state, byte) * 16);
-        byte = (*src & 0x0f);
-        *(buffer++) = (decode_sample(&decode_state, byte) * 16);
+        last = oki_decode(last, row, *src >> 4);
+        *(buffer++) = (Sample)(last * 16);
+        last = oki_decode(last, row, *src & 0x0f);
+        *(buffer++) = (Sample)(last * 16);
         ++src;
     }
+
+    decode_state.last = last;
+    decode_state.row = row;
     return (lsamples / 2) * 2;
 }
 
 AudioCodec *okiCodec::getByInfo(Info &info)
 {
-    return (AudioCodec *)new okiCodec(info.encoding);
+    AudioCodec *codec = reuse(info.encoding);
+
+    if(!codec)
+        codec = (AudioCodec *)new okiCodec(info.encoding);
+    return codec;
 }
 
 AudioCodec *okiCodec::getByFormat(const char *format)
 {
-    return (AudioCodec *)new okiCodec(info.encoding);
+    AudioCodec *codec = reuse(info.encoding);
+
+    if(!codec)
+        codec = (AudioCodec *)new okiCodec(info.encoding);
+    return codec;
 }
 
 #if defined(HAVE_GSM_H) || defined(HAVE_GSM_GSM_H)
@@ -1758,6 +3897,7 @@ private:
     __DELETE_COPY(GSMCodec);
 
     gsm encoder, decoder;
+    bool reset(void) __FINAL;
     AudioCodec *getByInfo(Info &info) __FINAL;
     AudioCodec *getByFormat(const char *format) __FINAL;
 
@@ -1799,20 +3939,44 @@ GSMCodec::~GSMCodec()
     gsm_destroy(decoder);
 }
 
+bool GSMCodec::reset(void)
+{
+    // libgsm has no reset call, so only the state blocks are renewed
+    if(!encoder || !decoder)
+        return false;
+
+    gsm_destroy(encoder);
+    gsm_destroy(decoder);
+    encoder = gsm_create();
+    decoder = gsm_create();
+    return true;
+}
+
 AudioCodec *GSMCodec::getByInfo(Info &info)
 {
-    return (AudioCodec *)new GSMCodec();
+    AudioCodec *codec = reuse(gsmVoice);
+
+    if(!codec)
+        codec = (AudioCodec *)new GSMCodec();
+    return codec;
 }
 
 AudioCodec *GSMCodec::getByFormat(const char *format)
 {
-    return (AudioCodec *)new GSMCodec();
+    AudioCodec *codec = reuse(gsmVoice);
+
+    if(!codec)
+        codec = (AudioCodec *)new GSMCodec();
+    return codec;
 }
 
+// like every other codec, gsm and speex report samples converted, so
+// callers can size output with toBytes() and step whole frames.
+
 unsigned GSMCodec::encode(Linear from, void *dest, unsigned samples)
 {
     unsigned count = samples / 160;
-    unsigned result = count * 33;
+    unsigned result = count * 160;
     gsm_byte *encoded = (gsm_byte *)dest;
 
     if(!count)
@@ -1829,15 +3993,17 @@ unsigned GSMCodec::encode(Linear from, void *dest, unsigned samples)
 unsigned GSMCodec::decode(Linear dest, void *from, unsigned samples)
 {
     unsigned count = samples / 160;
-    unsigned result = count * 33;
+    unsigned result = 0;
     gsm_byte *encoded = (gsm_byte *)from;
     if(!count)
         return 0;
 
     while(count--) {
-        gsm_decode(decoder, encoded, dest);
-        encoded += 160;
+        if(gsm_decode(decoder, encoded, dest))
+            break;
+        encoded += 33;
         dest += 160;
+        result += 160;
     }
     return result;
 }
@@ -1864,6 +4030,7 @@ protected:
     unsigned encode(Linear buffer, void *dest, unsigned lsamples) __OVERRIDE;
     unsigned decode(Linear buffer, void *source, unsigned lsamples) __OVERRIDE;
 
+    bool reset(void) __OVERRIDE;
     AudioCodec *getByInfo(Info &info) __OVERRIDE;
     AudioCodec *getByFormat(const char *format) __OVERRIDE;
 } speex_codec(Audio::speexVoice, "speex");
@@ -1905,6 +4072,7 @@ AudioCodec("speex", enc)
     case speexAudio:
         info.annotation = (char *)"speex/16000";
         info.framesize = 40;
+        info.framecount = 320;
         info.rate = 16000;
         spx_clock = 16000;
         spx_mode = &speex_wb_mode;
@@ -1935,21 +4103,51 @@ SpeexCommon::~SpeexCommon()
 
 AudioCodec *SpeexCommon::getByFormat(const char *format)
 {
-    if(!strnicmp(format, "speex/16", 8))
-        return (AudioCodec *)new SpeexAudio();
-    return (AudioCodec *)new SpeexVoice();
+    AudioCodec *codec;
+
+    if(!strnicmp(format, "speex/16", 8)) {
+        codec = reuse(speexAudio);
+        if(!codec)
+            codec = (AudioCodec *)new SpeexAudio();
+        return codec;
+    }
+
+    codec = reuse(speexVoice);
+    if(!codec)
+        codec = (AudioCodec *)new SpeexVoice();
+    return codec;
 }
 
 AudioCodec *SpeexCommon::getByInfo(Info &info)
 {
+    AudioCodec *codec;
+
     switch(info.encoding) {
     case speexAudio:
-            return (AudioCodec *)new SpeexAudio();
+        codec = reuse(speexAudio);
+        if(!codec)
+            codec = (AudioCodec *)new SpeexAudio();
+        return codec;
     default:
-        return (AudioCodec *)new SpeexVoice();
+        codec = reuse(speexVoice);
+        if(!codec)
+            codec = (AudioCodec *)new SpeexVoice();
+        return codec;
     }
 }
 
+bool SpeexCommon::reset(void)
+{
+    if(!encoder || !decoder)
+        return false;
+
+    speex_encoder_ctl(encoder, SPEEX_RESET_STATE, NULL);
+    speex_decoder_ctl(decoder, SPEEX_RESET_STATE, NULL);
+    speex_bits_reset(&enc_bits);
+    speex_bits_reset(&dec_bits);
+    return true;
+}
+
 unsigned SpeexCommon::decode(Linear buffer, void *src, unsigned lsamples)
 {
     unsigned count = lsamples / info.framecount;
@@ -1963,7 +4161,9 @@ unsigned SpeexCommon::decode(Linear buffer, void *src, unsigned lsamples)
         speex_bits_read_from(&dec_bits, encoded, info.framesize);
         if(speex_decode_int(decoder, &dec_bits, buffer))
             break;
-        result += info.framesize;
+        encoded += info.framesize;
+        buffer += info.framecount;
+        result += info.framecount;
     }
     return result;
 }
@@ -1981,10 +4181,10 @@ unsigned SpeexCommon::encode(Linear buffer, void *dest, unsigned lsamples)
         speex_bits_reset(&enc_bits);
         speex_encoder_ctl(encoder, SPEEX_SET_SAMPLING_RATE, &spx_clock);
         speex_encode_int(encoder, buffer, &enc_bits);
-        int nb = speex_bits_write(&enc_bits, encoded, info.framesize);
-        buffer += 160;
-        encoded += nb;
-        result += nb;
+        speex_bits_write(&enc_bits, encoded, info.framesize);
+        buffer += info.framecount;
+        encoded += info.framesize;
+        result += info.framecount;
     }
     return result;
 }
@@ -1992,7 +4192,7 @@ unsigned SpeexCommon::encode(Linear buffer, void *dest, unsigned lsamples)
 SpeexAudio::SpeexAudio() :
 SpeexCommon()
 {
-    info.encoding = speexVoice;
+    info.encoding = speexAudio;
     info.framesize = 40;
     info.framecount = 160;
     info.rate = 16000;
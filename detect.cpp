@@ -66,48 +66,547 @@
 
 namespace ucommon {
 
-DTMFDetect::DTMFDetect()
+// the 18 goertzel filters run as contiguous float lanes: rows, columns,
+// their second harmonics, then fax and fax second harmonic, padded to
+// DTMF_LANES.  The lanes sit behind the public state block in the same
+// allocation.  A block of samples is run with every filter held in
+// vector registers, and kernels are bound once at static init.  Coded
+// input is held back rather than filtered while the block is too quiet
+// to ever pass a threshold, and only replayed if the block turns loud.
+
+#define DTMF_LANES          24
+#define DTMF_ROW            0
+#define DTMF_COL            4
+#define DTMF_ROW2ND         8
+#define DTMF_COL2ND         12
+#define DTMF_FAX            16
+#define DTMF_FAX2ND         17
+#define DTMF_BLOCK          102
+
+#if defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+#define DTMF_SSE2
+#include <emmintrin.h>
+#if __GNUC__ >= 5 || defined(__clang__)
+#define DTMF_AVX
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define DTMF_NEON
+#include <arm_neon.h>
+#endif
+
+// decision limits for one sample rate.  The block keeps its 12.75ms
+// length, so tone energies grow with the square of the block and their
+// share of the block energy grows with the block.
+
+typedef struct {
+    ToneDetect::profile_t profile;
+    double fax_threshold, fax_snr;
+    unsigned block, gate;
+} dtmf_rate_t;
+
+typedef struct {
+    Audio::dtmf_detect_state_t base;
+    float v2[DTMF_LANES];
+    float v3[DTMF_LANES];
+    float fac[DTMF_LANES];
+    const float *table;
+    unsigned char held[DTMF_BLOCK];
+    unsigned hold, gate;
+    dtmf_rate_t setup;
+} dtmf_bank_t;
+
+// the kernels take linear samples, or g.711 codes which are decoded
+// through a float table as they are fed to the filters.
+
+typedef void (*dtmf_update_t)(dtmf_bank_t *bank, const Audio::Sample *amp, const float *table, unsigned count);
+typedef void (*dtmf_coded_t)(dtmf_bank_t *bank, const unsigned char *amp, const float *table, unsigned count);
+
+static inline float dtmf_load(const Audio::Sample *amp, const float *)
+{
+    return *amp;
+}
+
+static inline float dtmf_load(const unsigned char *amp, const float *table)
+{
+    return table[*amp];
+}
+
+template<typename T>
+static void dtmf_update_scalar(dtmf_bank_t *bank, const T *amp, const float *table, unsigned count)
+{
+    float energy = bank->base.energy, famp, v1;
+    unsigned lane;
+
+    while(count--) {
+        famp = dtmf_load(amp++, table);
+        energy += famp * famp;
+        for(lane = 0; lane < DTMF_LANES; ++lane) {
+            v1 = bank->v2[lane];
+            bank->v2[lane] = bank->v3[lane];
+            bank->v3[lane] = bank->fac[lane] * bank->v2[lane] - v1 + famp;
+        }
+    }
+    bank->base.energy = energy;
+}
+
+#ifdef  DTMF_SSE2
+template<typename T>
+static void dtmf_update_sse2(dtmf_bank_t *bank, const T *amp, const float *table, unsigned count)
+{
+    __m128 v2[6], v3[6], fac[6], x, v1;
+    float energy = bank->base.energy, famp;
+    unsigned lane;
+
+    for(lane = 0; lane < 6; ++lane) {
+        v2[lane] = _mm_loadu_ps(bank->v2 + lane * 4);
+        v3[lane] = _mm_loadu_ps(bank->v3 + lane * 4);
+        fac[lane] = _mm_loadu_ps(bank->fac + lane * 4);
+    }
+
+    while(count--) {
+        famp = dtmf_load(amp++, table);
+        energy += famp * famp;
+        x = _mm_set1_ps(famp);
+        for(lane = 0; lane < 6; ++lane) {
+            v1 = v2[lane];
+            v2[lane] = v3[lane];
+            v3[lane] = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(fac[lane], v2[lane]), v1), x);
+        }
+    }
+
+    for(lane = 0; lane < 6; ++lane) {
+        _mm_storeu_ps(bank->v2 + lane * 4, v2[lane]);
+        _mm_storeu_ps(bank->v3 + lane * 4, v3[lane]);
+    }
+    bank->base.energy = energy;
+}
+#endif
+
+#ifdef  DTMF_AVX
+template<typename T>
+static __attribute__((target("avx"))) void dtmf_update_avx(dtmf_bank_t *bank, const T *amp, const float *table, unsigned count)
+{
+    __m256 v2[3], v3[3], fac[3], x, v1;
+    float energy = bank->base.energy, famp;
+    unsigned lane;
+
+    for(lane = 0; lane < 3; ++lane) {
+        v2[lane] = _mm256_loadu_ps(bank->v2 + lane * 8);
+        v3[lane] = _mm256_loadu_ps(bank->v3 + lane * 8);
+        fac[lane] = _mm256_loadu_ps(bank->fac + lane * 8);
+    }
+
+    while(count--) {
+        famp = dtmf_load(amp++, table);
+        energy += famp * famp;
+        x = _mm256_set1_ps(famp);
+        for(lane = 0; lane < 3; ++lane) {
+            v1 = v2[lane];
+            v2[lane] = v3[lane];
+            v3[lane] = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(fac[lane], v2[lane]), v1), x);
+        }
+    }
+
+    for(lane = 0; lane < 3; ++lane) {
+        _mm256_storeu_ps(bank->v2 + lane * 8, v2[lane]);
+        _mm256_storeu_ps(bank->v3 + lane * 8, v3[lane]);
+    }
+    bank->base.energy = energy;
+}
+#endif
+
+#ifdef  DTMF_NEON
+template<typename T>
+static void dtmf_update_neon(dtmf_bank_t *bank, const T *amp, const float *table, unsigned count)
+{
+    float32x4_t v2[6], v3[6], fac[6], x, v1;
+    float energy = bank->base.energy, famp;
+    unsigned lane;
+
+    for(lane = 0; lane < 6; ++lane) {
+        v2[lane] = vld1q_f32(bank->v2 + lane * 4);
+        v3[lane] = vld1q_f32(bank->v3 + lane * 4);
+        fac[lane] = vld1q_f32(bank->fac + lane * 4);
+    }
+
+    while(count--) {
+        famp = dtmf_load(amp++, table);
+        energy += famp * famp;
+        x = vdupq_n_f32(famp);
+        for(lane = 0; lane < 6; ++lane) {
+            v1 = v2[lane];
+            v2[lane] = v3[lane];
+            v3[lane] = vaddq_f32(vsubq_f32(vmulq_f32(fac[lane], v2[lane]), v1), x);
+        }
+    }
+
+    for(lane = 0; lane < 6; ++lane) {
+        vst1q_f32(bank->v2 + lane * 4, v2[lane]);
+        vst1q_f32(bank->v3 + lane * 4, v3[lane]);
+    }
+    bank->base.energy = energy;
+}
+#endif
+
+// multi-channel detection keeps the goertzel state of DTMF_GROUP channels
+// per group in channel lanes, so one vector op advances the same filter
+// on every channel of the group.  Each tick's samples are transposed into
+// a block and the filters are run over it six at a time, which keeps
+// enough independent recurrences in flight to hide their latency.  The
+// per-channel arithmetic is the same as DTMFDetect, so decisions match.
+
+#define DTMF_FILTERS    18
+#define DTMF_GROUP      8
+#define DTMF_PASS       6
+
+typedef struct {
+    float v2[DTMF_FILTERS][DTMF_GROUP];
+    float v3[DTMF_FILTERS][DTMF_GROUP];
+    float energy[DTMF_GROUP];
+} dtmf_group_t;
+
+typedef void (*dtmf_cross_t)(dtmf_group_t *group, const float *block, unsigned count);
+
+static float dtmf_fac[DTMF_FILTERS];
+
+static void dtmf_cross_scalar(dtmf_group_t *group, const float *block, unsigned count)
+{
+    unsigned pos, lane, filter;
+    float famp, v1;
+
+    for(pos = 0; pos < count; ++pos) {
+        for(lane = 0; lane < DTMF_GROUP; ++lane) {
+            famp = block[pos * DTMF_GROUP + lane];
+            group->energy[lane] += famp * famp;
+            for(filter = 0; filter < DTMF_FILTERS; ++filter) {
+                v1 = group->v2[filter][lane];
+                group->v2[filter][lane] = group->v3[filter][lane];
+                group->v3[filter][lane] = dtmf_fac[filter] * group->v2[filter][lane] - v1 + famp;
+            }
+        }
+    }
+}
+
+#ifdef  DTMF_SSE2
+static void dtmf_cross_sse2(dtmf_group_t *group, const float *block, unsigned count)
+{
+    __m128 v2[DTMF_PASS], v3[DTMF_PASS], fac[DTMF_PASS], x, v1, energy;
+    unsigned half, base, filter, pos;
+
+    for(half = 0; half < DTMF_GROUP; half += 4) {
+        energy = _mm_loadu_ps(group->energy + half);
+        for(pos = 0; pos < count; ++pos) {
+            x = _mm_loadu_ps(block + pos * DTMF_GROUP + half);
+            energy = _mm_add_ps(energy, _mm_mul_ps(x, x));
+        }
+        _mm_storeu_ps(group->energy + half, energy);
+
+        for(base = 0; base < DTMF_FILTERS; base += DTMF_PASS) {
+            for(filter = 0; filter < DTMF_PASS; ++filter) {
+                v2[filter] = _mm_loadu_ps(&group->v2[base + filter][half]);
+                v3[filter] = _mm_loadu_ps(&group->v3[base + filter][half]);
+                fac[filter] = _mm_set1_ps(dtmf_fac[base + filter]);
+            }
+            for(pos = 0; pos < count; ++pos) {
+                x = _mm_loadu_ps(block + pos * DTMF_GROUP + half);
+                for(filter = 0; filter < DTMF_PASS; ++filter) {
+                    v1 = v2[filter];
+                    v2[filter] = v3[filter];
+                    v3[filter] = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(fac[filter], v2[filter]), v1), x);
+                }
+            }
+            for(filter = 0; filter < DTMF_PASS; ++filter) {
+                _mm_storeu_ps(&group->v2[base + filter][half], v2[filter]);
+                _mm_storeu_ps(&group->v3[base + filter][half], v3[filter]);
+            }
+        }
+    }
+}
+#endif
+
+#ifdef  DTMF_AVX
+static __attribute__((target("avx"))) void dtmf_cross_avx(dtmf_group_t *group, const float *block, unsigned count)
+{
+    __m256 v2[DTMF_PASS], v3[DTMF_PASS], fac[DTMF_PASS], x, v1, energy;
+    unsigned base, filter, pos;
+
+    energy = _mm256_loadu_ps(group->energy);
+    for(pos = 0; pos < count; ++pos) {
+        x = _mm256_loadu_ps(block + pos * DTMF_GROUP);
+        energy = _mm256_add_ps(energy, _mm256_mul_ps(x, x));
+    }
+    _mm256_storeu_ps(group->energy, energy);
+
+    for(base = 0; base < DTMF_FILTERS; base += DTMF_PASS) {
+        for(filter = 0; filter < DTMF_PASS; ++filter) {
+            v2[filter] = _mm256_loadu_ps(group->v2[base + filter]);
+            v3[filter] = _mm256_loadu_ps(group->v3[base + filter]);
+            fac[filter] = _mm256_set1_ps(dtmf_fac[base + filter]);
+        }
+        for(pos = 0; pos < count; ++pos) {
+            x = _mm256_loadu_ps(block + pos * DTMF_GROUP);
+            for(filter = 0; filter < DTMF_PASS; ++filter) {
+                v1 = v2[filter];
+                v2[filter] = v3[filter];
+                v3[filter] = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(fac[filter], v2[filter]), v1), x);
+            }
+        }
+        for(filter = 0; filter < DTMF_PASS; ++filter) {
+            _mm256_storeu_ps(group->v2[base + filter], v2[filter]);
+            _mm256_storeu_ps(group->v3[base + filter], v3[filter]);
+        }
+    }
+}
+#endif
+
+#ifdef  DTMF_NEON
+static void dtmf_cross_neon(dtmf_group_t *group, const float *block, unsigned count)
+{
+    float32x4_t v2[DTMF_PASS], v3[DTMF_PASS], fac[DTMF_PASS], x, v1, energy;
+    unsigned half, base, filter, pos;
+
+    for(half = 0; half < DTMF_GROUP; half += 4) {
+        energy = vld1q_f32(group->energy + half);
+        for(pos = 0; pos < count; ++pos) {
+            x = vld1q_f32(block + pos * DTMF_GROUP + half);
+            energy = vaddq_f32(energy, vmulq_f32(x, x));
+        }
+        vst1q_f32(group->energy + half, energy);
+
+        for(base = 0; base < DTMF_FILTERS; base += DTMF_PASS) {
+            for(filter = 0; filter < DTMF_PASS; ++filter) {
+                v2[filter] = vld1q_f32(&group->v2[base + filter][half]);
+                v3[filter] = vld1q_f32(&group->v3[base + filter][half]);
+                fac[filter] = vdupq_n_f32(dtmf_fac[base + filter]);
+            }
+            for(pos = 0; pos < count; ++pos) {
+                x = vld1q_f32(block + pos * DTMF_GROUP + half);
+                for(filter = 0; filter < DTMF_PASS; ++filter) {
+                    v1 = v2[filter];
+                    v2[filter] = v3[filter];
+                    v3[filter] = vaddq_f32(vsubq_f32(vmulq_f32(fac[filter], v2[filter]), v1), x);
+                }
+            }
+            for(filter = 0; filter < DTMF_PASS; ++filter) {
+                vst1q_f32(&group->v2[base + filter][half], v2[filter]);
+                vst1q_f32(&group->v3[base + filter][half], v3[filter]);
+            }
+        }
+    }
+}
+#endif
+
+static dtmf_cross_t dtmf_cross = &dtmf_cross_scalar;
+static dtmf_update_t dtmf_update = &dtmf_update_scalar<Audio::Sample>;
+static dtmf_coded_t dtmf_coded = &dtmf_update_scalar<unsigned char>;
+
+// signed g.711 code values for the coded kernels, built from the codec
+// magnitude tables; both laws carry the sign in the top bit.
+
+extern __LOCAL unsigned ullevels[128], allevels[128];
+
+static float dtmf_ulaw[256], dtmf_alaw[256];
+static dtmf_rate_t dtmf_narrow;
+
+static float dtmf_factor(double freq)
+{
+    float theta = (float)(2.0 * M_PI * (freq / SAMPLE_RATE));
+
+    return (float)(2.0 * cos(theta));
+}
+
+// signalling presets for the generic detector.  Tones are listed low
+// group first for grouped matches; the symbols follow the position
+// returned by tone_match.  Block sizes are picked so adjacent tones fall
+// in separate goertzel bins, and the signal thresholds scale with the
+// square of the block size.
+
+const ToneDetect::profile_t ToneDetect::dtmf = {
+    "dtmf", ToneDetect::matchGroups, 8, 4, 102, 2,
+    {697.0, 770.0, 852.0, 941.0, 1209.0, 1336.0, 1477.0, 1633.0},
+    "123A" "456B" "789C" "*0#D",
+    DTMF_THRESHOLD, DTMF_NORMAL_TWIST, DTMF_REVERSE_TWIST,
+    DTMF_RELATIVE_PEAK_ROW, 42.0,
+    {DTMF_2ND_HARMONIC_ROW, DTMF_2ND_HARMONIC_COL}
+};
+
+const ToneDetect::profile_t ToneDetect::mfr1 = {
+    "mfr1", ToneDetect::matchPairs, 6, 0, 120, 2,
+    {700.0, 900.0, 1100.0, 1300.0, 1500.0, 1700.0},
+    "1247C" "358A" "69K" "0B" "S",
+    1.1e8, 4.0, 4.0, 6.3, 49.0,
+    {2.5, 2.5}
+};
+
+const ToneDetect::profile_t ToneDetect::r2forward = {
+    "r2f", ToneDetect::matchPairs, 6, 0, 133, 2,
+    {1380.0, 1500.0, 1620.0, 1740.0, 1860.0, 1980.0},
+    "1247B" "358C" "69D" "0E" "F",
+    1.4e8, 5.0, 5.0, 6.3, 54.0,
+    {2.5, 2.5}
+};
+
+const ToneDetect::profile_t ToneDetect::r2backward = {
+    "r2b", ToneDetect::matchPairs, 6, 0, 133, 2,
+    {1140.0, 1020.0, 900.0, 780.0, 660.0, 540.0},
+    "1247B" "358C" "69D" "0E" "F",
+    1.4e8, 5.0, 5.0, 6.3, 54.0,
+    {2.5, 2.5}
+};
+
+const ToneDetect::profile_t ToneDetect::supervision = {
+    "2600", ToneDetect::matchSingle, 1, 0, 160, 3,
+    {2600.0},
+    "B",
+    2.0e8, 1.0, 1.0, 1.0, 48.0,
+    {0.0, 0.0}
+};
+
+static void dtmf_scale(dtmf_rate_t *setup, double rate)
+{
+    double scale;
+
+    setup->block = (unsigned)(DTMF_BLOCK * rate / SAMPLE_RATE + 0.5);
+    scale = (double)setup->block / DTMF_BLOCK;
+
+    setup->profile = ToneDetect::dtmf;
+    setup->profile.block = setup->block;
+    setup->profile.threshold *= scale * scale;
+    setup->profile.snr *= scale;
+    setup->fax_threshold = FAX_THRESHOLD * scale * scale;
+    setup->fax_snr = 21.0 * scale;
+
+    // no goertzel energy can exceed the square of the block's magnitude
+    // sum, so a block summing below the gate cannot reach either
+    // threshold.  Only narrowband blocks fit the coded hold buffer.
+    setup->gate = 0;
+    if(setup->block == DTMF_BLOCK)
+        setup->gate = (unsigned)(sqrt(setup->profile.threshold < setup->fax_threshold ?
+            setup->profile.threshold : setup->fax_threshold) * 0.9);
+}
+
+static class __LOCAL dtmfselect
+{
+public:
+    dtmfselect();
+} dtmf_select;
+
+dtmfselect::dtmfselect()
+{
+    const float *dtmf_row = ToneDetect::dtmf.tones;
+    const float *dtmf_col = ToneDetect::dtmf.tones + 4;
+    static float fax_freq = 1100.0;
+    unsigned i;
+
+    for(i = 0; i < 4; ++i) {
+        dtmf_fac[DTMF_ROW + i] = dtmf_factor(dtmf_row[i]);
+        dtmf_fac[DTMF_COL + i] = dtmf_factor(dtmf_col[i]);
+        dtmf_fac[DTMF_ROW2ND + i] = dtmf_factor(dtmf_row[i] * 2.0);
+        dtmf_fac[DTMF_COL2ND + i] = dtmf_factor(dtmf_col[i] * 2.0);
+    }
+    dtmf_fac[DTMF_FAX] = dtmf_factor(fax_freq);
+    dtmf_fac[DTMF_FAX2ND] = dtmf_factor(fax_freq * 2.0);
+
+    for(i = 0; i < 128; ++i) {
+        dtmf_ulaw[i] = -(float)ullevels[i];
+        dtmf_ulaw[i + 128] = (float)ullevels[i];
+        dtmf_alaw[i] = -(float)allevels[i];
+        dtmf_alaw[i + 128] = (float)allevels[i];
+    }
+
+    dtmf_scale(&dtmf_narrow, SAMPLE_RATE);
+
+#ifdef  DTMF_SSE2
+    dtmf_update = &dtmf_update_sse2<Audio::Sample>;
+    dtmf_coded = &dtmf_update_sse2<unsigned char>;
+    dtmf_cross = &dtmf_cross_sse2;
+#endif
+
+#ifdef  DTMF_AVX
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx")) {
+        dtmf_update = &dtmf_update_avx<Audio::Sample>;
+        dtmf_coded = &dtmf_update_avx<unsigned char>;
+        dtmf_cross = &dtmf_cross_avx;
+    }
+#endif
+
+#ifdef  DTMF_NEON
+    dtmf_update = &dtmf_update_neon<Audio::Sample>;
+    dtmf_coded = &dtmf_update_neon<unsigned char>;
+    dtmf_cross = &dtmf_cross_neon;
+#endif
+}
+
+static inline float dtmf_result(dtmf_bank_t *bank, unsigned lane)
+{
+    return bank->v3[lane] * bank->v3[lane] + bank->v2[lane] * bank->v2[lane] -
+        bank->v2[lane] * bank->v3[lane] * bank->fac[lane];
+}
+
+static inline void dtmf_reset(dtmf_bank_t *bank)
+{
+    memset(bank->v2, 0, sizeof(bank->v2));
+    memset(bank->v3, 0, sizeof(bank->v3));
+    bank->base.energy = 0.0;
+    bank->hold = bank->gate = 0;
+}
+
+static inline void dtmf_release(dtmf_bank_t *bank)
+{
+    if(bank->hold)
+        dtmf_coded(bank, bank->held, bank->table, bank->hold);
+    bank->hold = bank->gate = 0;
+}
+
+DTMFDetect::DTMFDetect(Rate rate)
 {
     int i;
     float theta;
-    static float dtmf_row[] = { 697.0, 770.0, 852.0, 941.0 };
-    static float dtmf_col[] = { 1209.0, 1336.0, 1477.0, 1633.0 };
+    double sample_rate = (rate == rateUnknown) ? SAMPLE_RATE : (double)rate;
+    dtmf_bank_t *bank;
+    const float *dtmf_row = ToneDetect::dtmf.tones;
+    const float *dtmf_col = ToneDetect::dtmf.tones + 4;
     static float fax_freq = 1100.0;
 
-    state = (dtmf_detect_state_t *)malloc(sizeof(dtmf_detect_state_t));
-    memset(state, 0, sizeof(dtmf_detect_state_t));
+    bank = (dtmf_bank_t *)malloc(sizeof(dtmf_bank_t));
+    memset(bank, 0, sizeof(dtmf_bank_t));
+    state = &bank->base;
+    windows = NULL;
+    dtmf_scale(&bank->setup, sample_rate);
 
     for(i = 0; i < 4; i++)
     {
-        theta = (float)(2.0 * M_PI * (dtmf_row[i] / SAMPLE_RATE));
+        theta = (float)(2.0 * M_PI * (dtmf_row[i] / sample_rate));
         dtmf_detect_row[i].fac = (float)(2.0 * cos(theta));
 
-        theta = (float)(2.0 * M_PI * (dtmf_col[i] / SAMPLE_RATE));
+        theta = (float)(2.0 * M_PI * (dtmf_col[i] / sample_rate));
         dtmf_detect_col[i].fac = (float)(2.0 * cos(theta));
 
-        theta = (float)(2.0 * M_PI * (dtmf_row[i] * 2.0 / SAMPLE_RATE));
+        theta = (float)(2.0 * M_PI * (dtmf_row[i] * 2.0 / sample_rate));
         dtmf_detect_row_2nd[i].fac = (float)(2.0 * cos(theta));
 
-        theta = (float)(2.0 * M_PI * (dtmf_col[i] * 2.0 / SAMPLE_RATE));
+        theta = (float)(2.0 * M_PI * (dtmf_col[i] * 2.0 / sample_rate));
         dtmf_detect_col_2nd[i].fac = (float)(2.0 * cos(theta));
 
-        goertzelInit(&state->row_out[i], &dtmf_detect_row[i]);
-        goertzelInit(&state->col_out[i], &dtmf_detect_col[i]);
-        goertzelInit(&state->row_out2nd[i], &dtmf_detect_row_2nd[i]);
-        goertzelInit(&state->col_out2nd[i], &dtmf_detect_col_2nd[i]);
-
-        state->energy = 0.0;
+        bank->fac[DTMF_ROW + i] = dtmf_detect_row[i].fac;
+        bank->fac[DTMF_COL + i] = dtmf_detect_col[i].fac;
+        bank->fac[DTMF_ROW2ND + i] = dtmf_detect_row_2nd[i].fac;
+        bank->fac[DTMF_COL2ND + i] = dtmf_detect_col_2nd[i].fac;
     }
 
     // Same for the fax detector
-    theta = (float)(2.0 * M_PI * (fax_freq / SAMPLE_RATE));
+    theta = (float)(2.0 * M_PI * (fax_freq / sample_rate));
     fax_detect.fac = (float)(2.0 * cos(theta));
-    goertzelInit(&state->fax_tone, &fax_detect);
+    bank->fac[DTMF_FAX] = fax_detect.fac;
 
     // Same for the fax detector 2nd harmonic
-    theta = (float)(2.0 * M_PI * (fax_freq / SAMPLE_RATE));
+    theta = (float)(2.0 * M_PI * (fax_freq * 2.0 / sample_rate));
     fax_detect_2nd.fac = (float)(2.0 * cos(theta));
-    goertzelInit(&state->fax_tone2nd, &fax_detect_2nd);
+    bank->fac[DTMF_FAX2ND] = fax_detect_2nd.fac;
 
     state->current_digits = 0;
     state->current_sample = 0;
@@ -119,6 +618,7 @@ DTMFDetect::DTMFDetect()
 
 DTMFDetect::~DTMFDetect()
 {
+    setWindow(0);
     if(state) {
         free(state);
         state = NULL;
@@ -152,212 +652,406 @@ float DTMFDetect::goertzelResult (goertzel_state_t *s)
     return s->v3 * s->v3 + s->v2 * s->v2 - s->v2 *s->v3 *s->fac;
 }
 
-int DTMFDetect::putSamples(Linear amp, int samples)
+// match a block against a tone profile.  Filter energies are indexed by
+// tone, with second harmonics following at energy[count].  Grouped
+// profiles take the strongest tone of each group, pair profiles the two
+// strongest tones overall, and single profiles the strongest tone; the
+// result is then put through the level, twist, relative peak, signal
+// to noise and harmonic tests.  Returns the symbol, or 0, and sets the
+// symbol position.
+
+static int tone_match(const ToneDetect::profile_t *profile, float total, const float *energy, unsigned *position)
+{
+    unsigned count = profile->count, split = profile->split;
+    unsigned first = 0, second = 0, ref, i;
+
+    switch(profile->match) {
+    case ToneDetect::matchGroups:
+        second = split;
+        for(i = 1; i < count; ++i) {
+            if(i < split && energy[i] > energy[first])
+                first = i;
+            else if(i > split && energy[i] > energy[second])
+                second = i;
+        }
+        *position = first * (count - split) + second - split;
+        break;
+    case ToneDetect::matchPairs:
+        second = 1;
+        if(energy[1] > energy[0]) {
+            first = 1;
+            second = 0;
+        }
+        for(i = 2; i < count; ++i) {
+            if(energy[i] > energy[first]) {
+                second = first;
+                first = i;
+            }
+            else if(energy[i] > energy[second])
+                second = i;
+        }
+        if(first > second) {
+            i = first;
+            first = second;
+            second = i;
+        }
+        *position = first * (2 * count - first - 1) / 2 + second - first - 1;
+        break;
+    default:
+        for(i = 1; i < count; ++i) {
+            if(energy[i] > energy[first])
+                first = i;
+        }
+        second = first;
+        *position = first;
+        break;
+    }
+
+    // Basic signal level test and the twist test
+    if(energy[first] < profile->threshold || energy[second] < profile->threshold)
+        return 0;
+
+    if(first != second && !(energy[second] < energy[first] * profile->reverse &&
+        energy[second] * profile->normal > energy[first]))
+        return 0;
+
+    // Relative peak test
+    for(i = 0; i < count; ++i) {
+        if(profile->match == ToneDetect::matchGroups)
+            ref = (i < split) ? first : second;
+        else if(profile->match == ToneDetect::matchPairs && i == first)
+            continue;
+        else
+            ref = second;
+        if(i != ref && energy[i] * profile->relative > energy[ref])
+            return 0;
+    }
+
+    // ... signal to noise and second harmonic test
+    if(first == second) {
+        if(energy[first] <= profile->snr * total)
+            return 0;
+    }
+    else if((energy[first] + energy[second]) <= profile->snr * total)
+        return 0;
+
+    if(energy[count + second] * profile->harmonic[1] >= energy[second] ||
+        energy[count + first] * profile->harmonic[0] >= energy[first])
+        return 0;
+
+    return profile->symbols[*position];
+}
+
+// append a confirmed digit to the state's digit buffer
+static void dtmf_append(Audio::dtmf_detect_state_t *state, int hit)
+{
+    state->detected_digits++;
+    if(state->current_digits < 128) {
+        state->digits[state->current_digits++] = hit;
+        state->digits[state->current_digits] = '\0';
+    }
+    else
+        state->lost_digits++;
+}
+
+// block decision for the DTMFDetect engines; the filter energies are
+// indexed by lane and state->energy holds the block energy.  The fax
+// tone rides along in lanes past the dtmf profile.  Returns the hit for
+// the block.
+
+static int dtmf_decide(Audio::dtmf_detect_state_t *state, const dtmf_rate_t *setup, const float *energy)
 {
-    static char dtmf_positions[] = "123A" "456B" "789C" "*0#D";
-    float row_energy[4];
-    float col_energy[4];
     float fax_energy;
     float fax_energy_2nd;
-    float famp;
-    float v1;
-    int i;
-    int j;
+    unsigned position;
+    int hit;
+
+    fax_energy = energy[DTMF_FAX];
+    hit = tone_match(&setup->profile, state->energy, energy, &position);
+
+    // Look for two successive similar results
+    // The logic in the next test is:
+    //   We need two successive identical clean detects, with
+    //   something different preceeding it. This can work with
+    //   back to back differing digits. More importantly, it
+    //   can work with nasty phones that give a very wobbly start
+    //   to a digit.
+    if (hit && hit == state->hit3  &&  state->hit3 != state->hit2) {
+        state->mhit = hit;
+        state->digit_hits[position]++;
+        dtmf_append(state, hit);
+    }
+
+    if (!hit && (fax_energy >= setup->fax_threshold) && (fax_energy > state->energy * setup->fax_snr)) {
+        fax_energy_2nd = energy[DTMF_FAX2ND];
+        if (fax_energy_2nd * FAX_2ND_HARMONIC < fax_energy) {
+            // XXX Probably need better checking than just this the energy
+            hit = 'f';
+            state->fax_hits++;
+        } /* Don't reset fax hits counter */
+    } else {
+        if (state->fax_hits > 5) {
+            state->mhit = 'f';
+            dtmf_append(state, state->mhit);
+        }
+        state->fax_hits = 0;
+    }
+    state->hit1 = state->hit2;
+    state->hit2 = state->hit3;
+    state->hit3 = hit;
+    return hit;
+}
+
+// windowed detection makes a decision every hop samples over the last
+// block of samples, with hop dividing the block.  The filters run once
+// per hop sized chunk; each chunk's complex goertzel output is kept, and
+// a window is the sum of its chunks rotated to a common phase.  So the
+// overlapping windows cost one filter pass and a small combine.  A digit
+// is confirmed once confirm windows in a row agree, and is not repeated
+// until it has been missing from 2 * count - 1 windows in a row, which
+// with a hop of a whole block is the one differing block the block mode
+// asks for.  Its start is estimated from the first window: two tones
+// covering the last L samples of a window give tone energies of about
+// L/2 times the window energy.
+
+#define DTMF_WINDOWS    6
+
+typedef struct {
+    unsigned hop, confirm, count, fill, next, chunks, run, gap, fax;
+    int last, reported;
+    bool fresh;
+    unsigned long position, start, faxstart;
+    unsigned long offsets[128];
+    float cosw[DTMF_LANES], sinw[DTMF_LANES];
+    float rotre[DTMF_WINDOWS][DTMF_LANES], rotim[DTMF_WINDOWS][DTMF_LANES];
+    float re[DTMF_WINDOWS][DTMF_LANES], im[DTMF_WINDOWS][DTMF_LANES];
+    float power[DTMF_WINDOWS];
+    const dtmf_rate_t *setup;
+    dtmf_bank_t bank;
+} dtmf_slide_t;
+
+static inline void dtmf_feed(dtmf_bank_t *bank, const Audio::Sample *amp, const float *table, unsigned count)
+{
+    dtmf_update(bank, amp, table, count);
+}
+
+static inline void dtmf_feed(dtmf_bank_t *bank, const unsigned char *amp, const float *table, unsigned count)
+{
+    dtmf_coded(bank, amp, table, count);
+}
+
+static int dtmf_window(Audio::dtmf_detect_state_t *state, dtmf_slide_t *slide)
+{
+    float energy[DTMF_LANES], sumre[DTMF_LANES], sumim[DTMF_LANES];
+    float total = 0.0, fax_energy;
+    const float *re, *im, *rotre, *rotim;
+    const dtmf_rate_t *setup = slide->setup;
+    unsigned lane, chunk, slot = slide->next, position = 0, length;
+    unsigned long opened = slide->position - setup->block;
+    int hit;
+
+    memset(sumre, 0, sizeof(sumre));
+    memset(sumim, 0, sizeof(sumim));
+
+    // oldest chunk first, starting from the slot about to be reused
+    for(chunk = 0; chunk < slide->count; ++chunk) {
+        re = slide->re[slot];
+        im = slide->im[slot];
+        rotre = slide->rotre[chunk];
+        rotim = slide->rotim[chunk];
+        for(lane = 0; lane < DTMF_LANES; ++lane) {
+            sumre[lane] += re[lane] * rotre[lane] + im[lane] * rotim[lane];
+            sumim[lane] += im[lane] * rotre[lane] - re[lane] * rotim[lane];
+        }
+        total += slide->power[slot];
+        if(++slot >= slide->count)
+            slot = 0;
+    }
+
+    for(lane = 0; lane < DTMF_LANES; ++lane)
+        energy[lane] = sumre[lane] * sumre[lane] + sumim[lane] * sumim[lane];
+
+    fax_energy = energy[DTMF_FAX];
+    hit = tone_match(&setup->profile, total, energy, &position);
+
+    if(hit != slide->last) {
+        slide->run = 0;
+        slide->fresh = (hit != slide->reported || slide->gap >= 2 * slide->count - 1);
+        if(hit) {
+            length = (unsigned)(2.0 * (energy[DTMF_ROW + position / 4] +
+                energy[DTMF_COL + position % 4]) / total);
+            if(length > setup->block)
+                length = setup->block;
+            slide->start = opened + setup->block - length;
+        }
+    }
+    ++slide->run;
+
+    if(hit == slide->reported)
+        slide->gap = 0;
+    else
+        ++slide->gap;
+
+    if(hit && slide->fresh && slide->run == slide->confirm) {
+        state->mhit = slide->reported = hit;
+        state->digit_hits[position]++;
+        if(state->current_digits < 128)
+            slide->offsets[state->current_digits] = slide->start;
+        dtmf_append(state, hit);
+    }
+
+    // fax tone must hold as long as in block mode, counted in windows
+    if(!hit && fax_energy >= setup->fax_threshold && fax_energy > total * setup->fax_snr &&
+        energy[DTMF_FAX2ND] * FAX_2ND_HARMONIC < fax_energy) {
+        if(!slide->fax++)
+            slide->faxstart = opened;
+        hit = 'f';
+    }
+    else {
+        if(slide->fax * slide->hop > 5 * setup->block) {
+            state->mhit = 'f';
+            if(state->current_digits < 128)
+                slide->offsets[state->current_digits] = slide->faxstart;
+            dtmf_append(state, state->mhit);
+        }
+        slide->fax = 0;
+    }
+    slide->last = hit;
+    return hit;
+}
+
+template<typename T>
+static int dtmf_slide(Audio::dtmf_detect_state_t *state, dtmf_slide_t *slide, const T *amp, const float *table, int samples)
+{
+    dtmf_bank_t *bank = &slide->bank;
+    unsigned lane, slot, count;
+    int hit = 0;
+
+    while(samples > 0) {
+        count = slide->hop - slide->fill;
+        if((unsigned)samples < count)
+            count = samples;
+
+        dtmf_feed(bank, amp, table, count);
+        slide->fill += count;
+        slide->position += count;
+        amp += count;
+        samples -= count;
+        if(slide->fill < slide->hop)
+            continue;
+
+        // keep the chunk's complex output, phase referenced to its end
+        slot = slide->next;
+        for(lane = 0; lane < DTMF_LANES; ++lane) {
+            slide->re[slot][lane] = bank->v3[lane] - slide->cosw[lane] * bank->v2[lane];
+            slide->im[slot][lane] = slide->sinw[lane] * bank->v2[lane];
+        }
+        slide->power[slot] = bank->base.energy;
+        slide->next = (slot + 1) % slide->count;
+        slide->fill = 0;
+        dtmf_reset(bank);
+
+        if(slide->chunks < slide->count)
+            ++slide->chunks;
+        if(slide->chunks == slide->count)
+            hit = dtmf_window(state, slide);
+    }
+    if(!state->mhit || state->mhit != hit) {
+        state->mhit = 0;
+        return 0;
+    }
+    return hit;
+}
+
+void DTMFDetect::setWindow(unsigned hop, unsigned confirm)
+{
+    dtmf_slide_t *slide;
+    const dtmf_rate_t *setup = &((dtmf_bank_t *)state)->setup;
+    unsigned lane, chunk, minhop;
+    double theta;
+
+    if(windows) {
+        delete (dtmf_slide_t *)windows;
+        windows = NULL;
+    }
+
+    if(!hop)
+        return;
+
+    // hop is rounded down to a divisor of the block, or up when that
+    // would leave more than DTMF_WINDOWS chunks in a window.
+    minhop = (setup->block + DTMF_WINDOWS - 1) / DTMF_WINDOWS;
+    if(hop < minhop)
+        hop = minhop;
+    else if(hop > setup->block)
+        hop = setup->block;
+    while(setup->block % hop)
+        --hop;
+    if(hop < minhop) {
+        hop = minhop;
+        while(setup->block % hop)
+            ++hop;
+    }
+
+    slide = new dtmf_slide_t;
+    memset(slide, 0, sizeof(dtmf_slide_t));
+    slide->hop = hop;
+    slide->confirm = confirm ? confirm : 1;
+    slide->count = setup->block / hop;
+    slide->setup = setup;
+    memcpy(slide->bank.fac, ((dtmf_bank_t *)state)->fac, sizeof(slide->bank.fac));
+
+    // chunk k of a window ends (count - 1 - k) hops before the window,
+    // so its output is rotated forward by that many hops to share the
+    // window end as phase reference.
+    for(lane = 0; lane < DTMF_LANES; ++lane) {
+        theta = acos(slide->bank.fac[lane] / 2.0);
+        slide->cosw[lane] = (float)cos(theta);
+        slide->sinw[lane] = (float)sin(theta);
+        for(chunk = 0; chunk < slide->count; ++chunk) {
+            slide->rotre[chunk][lane] = (float)cos(theta * hop * (slide->count - 1 - chunk));
+            slide->rotim[chunk][lane] = (float)-sin(theta * hop * (slide->count - 1 - chunk));
+        }
+    }
+    windows = slide;
+}
+
+int DTMFDetect::putSamples(Linear amp, int samples)
+{
+    dtmf_bank_t *bank = (dtmf_bank_t *)state;
+    float energy[DTMF_LANES];
+    unsigned lane;
     int sample;
-    int best_row;
-    int best_col;
     int hit;
     int limit;
+    int block = (int)bank->setup.block;
+
+    if(windows)
+        return dtmf_slide(state, (dtmf_slide_t *)windows, amp, (const float *)NULL, samples);
 
     hit = 0;
     for (sample = 0;  sample < samples;  sample = limit)
     {
-        // 102 is optimised to meet the DTMF specs.
-        if ((samples - sample) >= (102 - state->current_sample))
-            limit = sample + (102 - state->current_sample);
+        // 102 at 8khz is optimised to meet the DTMF specs.
+        if ((samples - sample) >= (block - state->current_sample))
+            limit = sample + (block - state->current_sample);
         else
             limit = samples;
 
-        // The following unrolled loop takes only 35% (rough estimate) of the
-        // time of a rolled loop on the machine on which it was developed
-        for(j = sample;  j < limit;  j++)
-        {
-            famp = amp[j];
-            state->energy += famp*famp;
-
-            // With GCC 2.95, the following unrolled code seems to take about 35%
-            // (rough estimate) as long as a neat little 0-3 loop
-            v1 = state->row_out[0].v2;
-            state->row_out[0].v2 = state->row_out[0].v3;
-            state->row_out[0].v3 = state->row_out[0].fac*state->row_out[0].v2 - v1 + famp;
-
-            v1 = state->col_out[0].v2;
-            state->col_out[0].v2 = state->col_out[0].v3;
-            state->col_out[0].v3 = state->col_out[0].fac*state->col_out[0].v2 - v1 + famp;
-
-            v1 = state->row_out[1].v2;
-            state->row_out[1].v2 = state->row_out[1].v3;
-            state->row_out[1].v3 = state->row_out[1].fac*state->row_out[1].v2 - v1 + famp;
-
-            v1 = state->col_out[1].v2;
-            state->col_out[1].v2 = state->col_out[1].v3;
-            state->col_out[1].v3 = state->col_out[1].fac*state->col_out[1].v2 - v1 + famp;
-
-            v1 = state->row_out[2].v2;
-            state->row_out[2].v2 = state->row_out[2].v3;
-            state->row_out[2].v3 = state->row_out[2].fac*state->row_out[2].v2 - v1 + famp;
-
-            v1 = state->col_out[2].v2;
-            state->col_out[2].v2 = state->col_out[2].v3;
-            state->col_out[2].v3 = state->col_out[2].fac*state->col_out[2].v2 - v1 + famp;
-
-            v1 = state->row_out[3].v2;
-            state->row_out[3].v2 = state->row_out[3].v3;
-            state->row_out[3].v3 = state->row_out[3].fac*state->row_out[3].v2 - v1 + famp;
-
-            v1 = state->col_out[3].v2;
-            state->col_out[3].v2 = state->col_out[3].v3;
-            state->col_out[3].v3 = state->col_out[3].fac*state->col_out[3].v2 - v1 + famp;
-
-            v1 = state->col_out2nd[0].v2;
-            state->col_out2nd[0].v2 = state->col_out2nd[0].v3;
-            state->col_out2nd[0].v3 = state->col_out2nd[0].fac*state->col_out2nd[0].v2 - v1 + famp;
-
-            v1 = state->row_out2nd[0].v2;
-            state->row_out2nd[0].v2 = state->row_out2nd[0].v3;
-            state->row_out2nd[0].v3 = state->row_out2nd[0].fac*state->row_out2nd[0].v2 - v1 + famp;
-
-            v1 = state->col_out2nd[1].v2;
-            state->col_out2nd[1].v2 = state->col_out2nd[1].v3;
-            state->col_out2nd[1].v3 = state->col_out2nd[1].fac*state->col_out2nd[1].v2 - v1 + famp;
-
-            v1 = state->row_out2nd[1].v2;
-            state->row_out2nd[1].v2 = state->row_out2nd[1].v3;
-            state->row_out2nd[1].v3 = state->row_out2nd[1].fac*state->row_out2nd[1].v2 - v1 + famp;
-
-            v1 = state->col_out2nd[2].v2;
-            state->col_out2nd[2].v2 = state->col_out2nd[2].v3;
-            state->col_out2nd[2].v3 = state->col_out2nd[2].fac*state->col_out2nd[2].v2 - v1 + famp;
-
-            v1 = state->row_out2nd[2].v2;
-            state->row_out2nd[2].v2 = state->row_out2nd[2].v3;
-            state->row_out2nd[2].v3 = state->row_out2nd[2].fac*state->row_out2nd[2].v2 - v1 + famp;
-
-            v1 = state->col_out2nd[3].v2;
-            state->col_out2nd[3].v2 = state->col_out2nd[3].v3;
-            state->col_out2nd[3].v3 = state->col_out2nd[3].fac*state->col_out2nd[3].v2 - v1 + famp;
-
-            v1 = state->row_out2nd[3].v2;
-            state->row_out2nd[3].v2 = state->row_out2nd[3].v3;
-            state->row_out2nd[3].v3 = state->row_out2nd[3].fac*state->row_out2nd[3].v2 - v1 + famp;
-
-            v1 = state->fax_tone.v2;
-            state->fax_tone.v2 = state->fax_tone.v3;
-            state->fax_tone.v3 = state->fax_tone.fac*state->fax_tone.v2 - v1 + famp;
-
-            v1 = state->fax_tone.v2;
-            state->fax_tone2nd.v2 = state->fax_tone2nd.v3;
-            state->fax_tone2nd.v3 = state->fax_tone2nd.fac*state->fax_tone2nd.v2 - v1 + famp;
-        }
+        dtmf_release(bank);
+        dtmf_update(bank, amp + sample, NULL, limit - sample);
+
         state->current_sample += (limit - sample);
-        if(state->current_sample < 102)
+        if(state->current_sample < block)
             continue;
 
-        fax_energy = goertzelResult(&state->fax_tone);
-
         // We are at the end of a DTMF detection block
-        // Find the peak row and the peak column
-        row_energy[0] = goertzelResult (&state->row_out[0]);
-        col_energy[0] = goertzelResult (&state->col_out[0]);
-
-        for(best_row = best_col = 0, i = 1;  i < 4;  i++)
-        {
-            row_energy[i] = goertzelResult (&state->row_out[i]);
-            if(row_energy[i] > row_energy[best_row])
-                 best_row = i;
-            col_energy[i] = goertzelResult (&state->col_out[i]);
-            if(col_energy[i] > col_energy[best_col])
-                best_col = i;
-        }
-        hit = 0;
-
-        // Basic signal level test and the twist test
-        if(row_energy[best_row] >= DTMF_THRESHOLD &&
-            col_energy[best_col] >= DTMF_THRESHOLD &&
-            col_energy[best_col] < row_energy[best_row] * DTMF_REVERSE_TWIST &&
-            col_energy[best_col] * DTMF_NORMAL_TWIST > row_energy[best_row])
-        {
-            // Relative peak test
-            for(i = 0;  i < 4;  i++)
-            {
-                if ((i != best_col &&
-                    col_energy[i]*DTMF_RELATIVE_PEAK_COL > col_energy[best_col]) ||
-                    (i != best_row && row_energy[i]*DTMF_RELATIVE_PEAK_ROW > row_energy[best_row]))
-                    break;
-            }
-            // ... and second harmonic test
-            if(i >= 4 &&
-                (row_energy[best_row] + col_energy[best_col]) > 42.0*state->energy &&
-                goertzelResult (&state->col_out2nd[best_col])*DTMF_2ND_HARMONIC_COL < col_energy[best_col] &&
-                goertzelResult (&state->row_out2nd[best_row])*DTMF_2ND_HARMONIC_ROW < row_energy[best_row])
-            {
-                hit = dtmf_positions[(best_row << 2) + best_col];
-                // Look for two successive similar results
-                // The logic in the next test is:
-                //   We need two successive identical clean detects, with
-                //   something different preceeding it. This can work with
-                //   back to back differing digits. More importantly, it
-                //   can work with nasty phones that give a very wobbly start
-                //   to a digit.
-                if (hit == state->hit3  &&  state->hit3 != state->hit2) {
-                    state->mhit = hit;
-                    state->digit_hits[(best_row << 2) + best_col]++;
-                    state->detected_digits++;
-                    if (state->current_digits < 128) {
-                        state->digits[state->current_digits++] = hit;
-                        state->digits[state->current_digits] = '\0';
-                    }
-                    else {
-                        state->lost_digits++;
-                    }
-                }
-            }
-        }
+        for(lane = 0; lane < DTMF_LANES; ++lane)
+            energy[lane] = dtmf_result(bank, lane);
+        hit = dtmf_decide(state, &bank->setup, energy);
 
-        if (!hit && (fax_energy >= FAX_THRESHOLD) && (fax_energy > state->energy * 21.0)) {
-            fax_energy_2nd = goertzelResult(&state->fax_tone2nd);
-            if (fax_energy_2nd * FAX_2ND_HARMONIC < fax_energy) {
-                // XXX Probably need better checking than just this the energy
-                hit = 'f';
-                state->fax_hits++;
-            } /* Don't reset fax hits counter */
-        } else {
-            if (state->fax_hits > 5) {
-                state->mhit = 'f';
-                state->detected_digits++;
-                if (state->current_digits < 128) {
-                    state->digits[state->current_digits++] = hit;
-                    state->digits[state->current_digits] = '\0';
-                }
-                else
-                    state->lost_digits++;
-            }
-            state->fax_hits = 0;
-        }
-        state->hit1 = state->hit2;
-        state->hit2 = state->hit3;
-        state->hit3 = hit;
         // Reinitialise the detector for the next block
-        for (i = 0;  i < 4;  i++)
-        {
-            goertzelInit (&state->row_out[i], &dtmf_detect_row[i]);
-            goertzelInit (&state->col_out[i], &dtmf_detect_col[i]);
-            goertzelInit (&state->row_out2nd[i], &dtmf_detect_row_2nd[i]);
-            goertzelInit (&state->col_out2nd[i], &dtmf_detect_col_2nd[i]);
-        }
-        goertzelInit (&state->fax_tone, &fax_detect);
-        goertzelInit (&state->fax_tone2nd, &fax_detect_2nd);
-        state->energy = 0.0;
+        dtmf_reset(bank);
         state->current_sample = 0;
     }
     if ((!state->mhit) || (state->mhit != hit)) {
@@ -367,7 +1061,82 @@ int DTMFDetect::putSamples(Linear amp, int samples)
     return (hit);
 }
 
-int DTMFDetect::getResult(char *buf, int max)
+int DTMFDetect::putEncoded(Encoded data, int samples, Encoding encoding)
+{
+    dtmf_bank_t *bank = (dtmf_bank_t *)state;
+    const unsigned *levels;
+    const float *table;
+    float energy[DTMF_LANES];
+    unsigned lane, gate;
+    int sample, pos, limit, hit = 0;
+    int block = (int)bank->setup.block;
+
+    switch(encoding) {
+    case mulawAudio:
+        levels = ullevels;
+        table = dtmf_ulaw;
+        break;
+    case alawAudio:
+        levels = allevels;
+        table = dtmf_alaw;
+        break;
+    default:
+        return 0;
+    }
+
+    if(windows)
+        return dtmf_slide(state, (dtmf_slide_t *)windows, data, table, samples);
+
+    for(sample = 0; sample < samples; sample = limit) {
+        if((samples - sample) >= (block - state->current_sample))
+            limit = sample + (block - state->current_sample);
+        else
+            limit = samples;
+
+        // until something in the block reaches the filters, samples are
+        // held back for as long as the block stays below the gate.
+        gate = bank->setup.gate;
+        if(bank->hold == (unsigned)state->current_sample && (!bank->hold || bank->table == table)) {
+            gate = bank->gate;
+            for(pos = sample; pos < limit && gate < bank->setup.gate; ++pos)
+                gate += levels[data[pos] & 0x7f];
+        }
+
+        if(gate < bank->setup.gate) {
+            memcpy(bank->held + bank->hold, data + sample, limit - sample);
+            bank->hold += (limit - sample);
+            bank->table = table;
+            bank->gate = gate;
+        }
+        else {
+            dtmf_release(bank);
+            dtmf_coded(bank, data + sample, table, limit - sample);
+        }
+
+        state->current_sample += (limit - sample);
+        if(state->current_sample < block)
+            continue;
+
+        // a block held back whole has no energy worth measuring
+        if(bank->hold)
+            memset(energy, 0, sizeof(energy));
+        else {
+            for(lane = 0; lane < DTMF_LANES; ++lane)
+                energy[lane] = dtmf_result(bank, lane);
+        }
+        hit = dtmf_decide(state, &bank->setup, energy);
+
+        dtmf_reset(bank);
+        state->current_sample = 0;
+    }
+    if(!state->mhit || state->mhit != hit) {
+        state->mhit = 0;
+        return 0;
+    }
+    return hit;
+}
+
+static int dtmf_digits(Audio::dtmf_detect_state_t *state, char *buf, int max)
 {
     if (max > state->current_digits)
         max = state->current_digits;
@@ -380,4 +1149,219 @@ int DTMFDetect::getResult(char *buf, int max)
     return  max;
 }
 
+int DTMFDetect::getResult(char *buf, int max)
+{
+    return getResult(buf, max, NULL);
+}
+
+int DTMFDetect::getResult(char *buf, int max, unsigned long *offsets)
+{
+    dtmf_slide_t *slide = (dtmf_slide_t *)windows;
+    int count = max;
+
+    if(count > state->current_digits)
+        count = state->current_digits;
+
+    if(count > 0 && slide) {
+        if(offsets)
+            memcpy(offsets, slide->offsets, count * sizeof(unsigned long));
+        memmove(slide->offsets, slide->offsets + count, (state->current_digits - count) * sizeof(unsigned long));
+    }
+    else if(count > 0 && offsets)
+        memset(offsets, 0, count * sizeof(unsigned long));
+
+    return dtmf_digits(state, buf, max);
+}
+
+ToneDetect::ToneDetect(const profile_t& tones)
+{
+    dtmf_bank_t *lanes;
+    unsigned i;
+
+    profile = &tones;
+    lanes = (dtmf_bank_t *)malloc(sizeof(dtmf_bank_t));
+    memset(lanes, 0, sizeof(dtmf_bank_t));
+    bank = lanes;
+    run = 0;
+
+    for(i = 0; i < profile->count; ++i) {
+        lanes->fac[i] = dtmf_factor(profile->tones[i]);
+        lanes->fac[profile->count + i] = dtmf_factor(profile->tones[i] * 2.0);
+    }
+}
+
+ToneDetect::~ToneDetect()
+{
+    if(bank) {
+        free(bank);
+        bank = NULL;
+    }
+}
+
+void ToneDetect::reset(void)
+{
+    dtmf_bank_t *lanes = (dtmf_bank_t *)bank;
+
+    memset(&lanes->base, 0, sizeof(lanes->base));
+    dtmf_reset(lanes);
+    run = 0;
+}
+
+int ToneDetect::putSamples(Linear amp, int samples)
+{
+    dtmf_bank_t *lanes = (dtmf_bank_t *)bank;
+    dtmf_detect_state_t *state = &lanes->base;
+    int block = (int)profile->block;
+    float energy[DTMF_LANES];
+    unsigned lane, position;
+    int sample, limit, hit = 0;
+
+    for(sample = 0; sample < samples; sample = limit) {
+        if((samples - sample) >= (block - state->current_sample))
+            limit = sample + (block - state->current_sample);
+        else
+            limit = samples;
+
+        dtmf_update(lanes, amp + sample, NULL, limit - sample);
+
+        state->current_sample += (limit - sample);
+        if(state->current_sample < block)
+            continue;
+
+        for(lane = 0; lane < profile->count * 2; ++lane)
+            energy[lane] = dtmf_result(lanes, lane);
+        hit = tone_match(profile, state->energy, energy, &position);
+
+        // a symbol is reported once it holds for confirm blocks in a row
+        if(hit == state->hit3)
+            ++run;
+        else
+            run = 1;
+
+        if(hit && run == profile->confirm) {
+            state->mhit = hit;
+            dtmf_append(state, hit);
+        }
+
+        state->hit1 = state->hit2;
+        state->hit2 = state->hit3;
+        state->hit3 = hit;
+
+        dtmf_reset(lanes);
+        state->current_sample = 0;
+    }
+    if(!state->mhit || state->mhit != hit) {
+        state->mhit = 0;
+        return 0;
+    }
+    return hit;
+}
+
+int ToneDetect::getResult(char *data, int size)
+{
+    return dtmf_digits(&((dtmf_bank_t *)bank)->base, data, size);
+}
+
+DTMFDetectBank::DTMFDetectBank(unsigned count)
+{
+    channels = count;
+    groups = (count + DTMF_GROUP - 1) / DTMF_GROUP;
+    current = 0;
+
+    states = new dtmf_detect_state_t[channels];
+    memset(states, 0, sizeof(dtmf_detect_state_t) * channels);
+
+    lanes = new dtmf_group_t[groups];
+    memset(lanes, 0, sizeof(dtmf_group_t) * groups);
+}
+
+DTMFDetectBank::~DTMFDetectBank()
+{
+    delete[] states;
+    delete[] (dtmf_group_t *)lanes;
+}
+
+void DTMFDetectBank::reset(unsigned channel)
+{
+    dtmf_group_t *group = (dtmf_group_t *)lanes + channel / DTMF_GROUP;
+    unsigned lane = channel % DTMF_GROUP, filter;
+
+    if(channel >= channels)
+        return;
+
+    memset(&states[channel], 0, sizeof(dtmf_detect_state_t));
+    for(filter = 0; filter < DTMF_FILTERS; ++filter)
+        group->v2[filter][lane] = group->v3[filter][lane] = 0.0;
+    group->energy[lane] = 0.0;
+}
+
+unsigned DTMFDetectBank::putSamples(Linear *buffers, int samples, int *hits)
+{
+    float block[DTMF_BLOCK * DTMF_GROUP];
+    float energy[DTMF_LANES];
+    dtmf_group_t *group;
+    unsigned index, channel, lane, filter, pos, found = 0;
+    int sample, limit;
+
+    for(channel = 0; channel < channels; ++channel)
+        hits[channel] = 0;
+
+    for(sample = 0; sample < samples; sample = limit) {
+        if((unsigned)(samples - sample) >= DTMF_BLOCK - current)
+            limit = sample + (int)(DTMF_BLOCK - current);
+        else
+            limit = samples;
+
+        for(index = 0; index < groups; ++index) {
+            for(pos = 0; pos < (unsigned)(limit - sample); ++pos) {
+                for(lane = 0; lane < DTMF_GROUP; ++lane) {
+                    channel = index * DTMF_GROUP + lane;
+                    if(channel < channels)
+                        block[pos * DTMF_GROUP + lane] = buffers[channel][sample + pos];
+                    else
+                        block[pos * DTMF_GROUP + lane] = 0.0;
+                }
+            }
+            dtmf_cross((dtmf_group_t *)lanes + index, block, limit - sample);
+        }
+
+        current += (limit - sample);
+        if(current < DTMF_BLOCK)
+            continue;
+
+        for(channel = 0; channel < channels; ++channel) {
+            group = (dtmf_group_t *)lanes + channel / DTMF_GROUP;
+            lane = channel % DTMF_GROUP;
+            for(filter = 0; filter < DTMF_FILTERS; ++filter)
+                energy[filter] = group->v3[filter][lane] * group->v3[filter][lane] +
+                    group->v2[filter][lane] * group->v2[filter][lane] -
+                    group->v2[filter][lane] * group->v3[filter][lane] * dtmf_fac[filter];
+            states[channel].energy = group->energy[lane];
+            hits[channel] = dtmf_decide(&states[channel], &dtmf_narrow, energy);
+        }
+
+        memset(lanes, 0, sizeof(dtmf_group_t) * groups);
+        current = 0;
+    }
+
+    for(channel = 0; channel < channels; ++channel) {
+        if(!states[channel].mhit || states[channel].mhit != hits[channel]) {
+            states[channel].mhit = 0;
+            hits[channel] = 0;
+        }
+        else
+            ++found;
+    }
+    return found;
+}
+
+int DTMFDetectBank::getResult(unsigned channel, char *data, int size)
+{
+    if(channel >= channels) {
+        data[0] = 0;
+        return 0;
+    }
+    return dtmf_digits(&states[channel], data, size);
+}
+
 } // namespace ucommon
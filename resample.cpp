@@ -21,10 +21,647 @@
 #include <ccaudio2-config.h>
 #include <ucommon/export.h>
 #include <ccaudio2.h>
+#include <math.h>
+
+#if defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+#define RESAMPLE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RESAMPLE_NEON
+#include <arm_neon.h>
+#endif
+
+#ifndef M_PI
+#define M_PI    3.14159265358979323846
+#endif
 
 namespace ucommon {
 
-AudioResample::AudioResample(Rate div, Rate mul)
+#define RESAMPLE_TAPS       48
+#define RESAMPLE_CHUNK      256
+#define RESAMPLE_ROLLOFF    0.94
+#define RESAMPLE_BETA       8.0
+#define BAND_TAPS           40
+#define FRACTION_TAPS       32
+#define FRACTION_MAXTAPS    256
+#define FRACTION_BITS       6
+#define FRACTION_PHASES     (1 << FRACTION_BITS)
+
+static double resample_bessel(double x)
+{
+    double sum = 1.0, term = 1.0;
+    unsigned k;
+
+    for(k = 1; k < 32; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+static inline int resample_dot(const Audio::Sample *x, const Audio::Sample *h, unsigned taps)
+{
+    unsigned pos = 0;
+    int sum = 0;
+
+#if defined(RESAMPLE_SSE2)
+    __m128i acc = _mm_setzero_si128();
+
+    for(; pos < taps; pos += 8)
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(
+            _mm_loadu_si128((const __m128i *)(x + pos)),
+            _mm_loadu_si128((const __m128i *)(h + pos))));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0x4e));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0xb1));
+    sum = _mm_cvtsi128_si32(acc);
+#elif defined(RESAMPLE_NEON)
+    int32x4_t acc = vdupq_n_s32(0);
+    int32x2_t half;
+
+    for(; pos < taps; pos += 8) {
+        int16x8_t xv = vld1q_s16(x + pos), hv = vld1q_s16(h + pos);
+        acc = vmlal_s16(acc, vget_low_s16(xv), vget_low_s16(hv));
+        acc = vmlal_s16(acc, vget_high_s16(xv), vget_high_s16(hv));
+    }
+    half = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+    sum = vget_lane_s32(vpadd_s32(half, half), 0);
+#else
+    for(; pos < taps; ++pos)
+        sum += x[pos] * h[pos];
+#endif
+    return sum;
+}
+
+// fixed ratio fast paths for the telephony rates.  A nyquist band
+// lowpass for factor F has every Fth tap zero except the center, so the
+// zero phase of an interpolator is a plain delayed copy of the input and
+// a decimator only runs the F-1 dense phases over deinterleaved input.
+// 6x is cascaded from the 2x and 3x stages, sharpest filter at the low
+// rate.  AudioResample picks these whenever its reduced ratio matches.
+
+// filter designs are immutable once built and shared process wide by
+// every resampler of the same kind, ratio and quality.  A design is built
+// outside design_lock and rechecked before it is linked, so a racing
+// duplicate is dropped; designs live for the life of the process.
+
+enum {
+    designBand = 0,
+    designFraction,
+    designPolyphase
+};
+
+typedef struct {
+    unsigned kind, mul, div, size;
+    unsigned taps;
+    Audio::Sample *bank;
+    unsigned *steps;
+} design_t;
+
+class __LOCAL designed : public LinkedObject
+{
+public:
+    design_t design;
+
+    inline designed(LinkedObject **root) : LinkedObject(root) {}
+};
+
+static LinkedObject *designs = NULL;
+static Mutex design_lock;
+
+static inline Audio::Sample design_coef(double value)
+{
+    value = floor(value + 0.5);
+    if(value > 32767.0)
+        return 32767;
+    if(value < -32767.0)
+        return -32767;
+    return (Audio::Sample)value;
+}
+
+// nyquist band lowpass for factor mul, dense phases only
+static void band_design(design_t *design)
+{
+    unsigned factor = design->mul, length = factor * BAND_TAPS, phase, k, n;
+    double center = length / 2.0, arg, value;
+    double scale = 32768.0 / resample_bessel(RESAMPLE_BETA);
+    Audio::Sample *bank;
+
+    design->taps = BAND_TAPS;
+    design->bank = bank = new Audio::Sample[(factor - 1) * BAND_TAPS];
+
+    for(phase = 1; phase < factor; ++phase) {
+        for(k = 0; k < BAND_TAPS; ++k) {
+            n = phase + (BAND_TAPS - 1 - k) * factor;
+            arg = (n - center) / factor;
+            value = sin(M_PI * arg) / (M_PI * arg);
+            arg = (n - center) / center;
+            value *= scale * resample_bessel(RESAMPLE_BETA * sqrt(fabs(1.0 - arg * arg)));
+            *(bank++) = design_coef(value);
+        }
+    }
+}
+
+// FRACTION_PHASES + 1 fractional delays of a lowpass at the narrower rate
+static void fraction_design(design_t *design)
+{
+    unsigned mul = design->mul, div = design->div, taps, phase, k;
+    double ratio = (double)mul / div, cutoff, center, arg, value, scale;
+
+    if(ratio > 1.0)
+        ratio = 1.0;
+
+    taps = design->size * ((div + mul - 1) / mul);
+    if(taps > FRACTION_MAXTAPS)
+        taps = FRACTION_MAXTAPS;
+
+    cutoff = 0.5 * RESAMPLE_ROLLOFF * ratio;
+    center = taps / 2 - 1;
+    scale = 32768.0 * 2.0 * cutoff / resample_bessel(RESAMPLE_BETA);
+
+    design->taps = taps;
+    design->bank = new Audio::Sample[(FRACTION_PHASES + 1) * taps];
+
+    for(phase = 0; phase <= FRACTION_PHASES; ++phase) {
+        for(k = 0; k < taps; ++k) {
+            arg = k - center - (double)phase / FRACTION_PHASES;
+            value = 2.0 * cutoff * arg;
+            value = (fabs(value) < 1e-9) ? 1.0 : sin(M_PI * value) / (M_PI * value);
+            arg /= (taps / 2.0);
+            value *= scale * resample_bessel(RESAMPLE_BETA * sqrt(fabs(1.0 - arg * arg)));
+            design->bank[phase * taps + k] = design_coef(value);
+        }
+    }
+}
+
+// one reversed bank per phase of an L/M polyphase filter, with steps
+static void polyphase_design(design_t *design)
+{
+    unsigned mul = design->mul, div = design->div;
+    unsigned widest = (mul > div) ? mul : div;
+    unsigned taps, phase, k, n, length;
+    double cutoff, center, arg, value, scale;
+
+    taps = design->size * ((widest + mul - 1) / mul);
+    taps = (taps + 7) & ~7u;
+
+    length = taps * mul;
+    cutoff = 0.5 * RESAMPLE_ROLLOFF / widest;
+    center = (length - 1) / 2.0;
+    scale = 32768.0 * 2.0 * cutoff * mul / resample_bessel(RESAMPLE_BETA);
+
+    design->taps = taps;
+    design->bank = new Audio::Sample[mul * taps];
+    design->steps = new unsigned[mul * 2];
+
+    for(phase = 0; phase < mul; ++phase) {
+        for(k = 0; k < taps; ++k) {
+            n = phase + (taps - 1 - k) * mul;
+            arg = 2.0 * cutoff * (n - center);
+            value = (fabs(arg) < 1e-9) ? 1.0 : sin(M_PI * arg) / (M_PI * arg);
+            arg = 2.0 * (n - center) / (length - 1);
+            value *= scale * resample_bessel(RESAMPLE_BETA * sqrt(fabs(1.0 - arg * arg)));
+            design->bank[phase * taps + k] = design_coef(value);
+        }
+        design->steps[phase * 2] = (phase + div) / mul;
+        design->steps[phase * 2 + 1] = (phase + div) % mul;
+    }
+}
+
+static designed *design_find(unsigned kind, unsigned mul, unsigned div, unsigned size)
+{
+    linked_pointer<designed> dp = designs;
+
+    while(is(dp)) {
+        if(dp->design.kind == kind && dp->design.mul == mul &&
+            dp->design.div == div && dp->design.size == size)
+            return *dp;
+        dp.next();
+    }
+    return NULL;
+}
+
+static const design_t *design_get(unsigned kind, unsigned mul, unsigned div, unsigned size)
+{
+    designed *found;
+    design_t design;
+
+    design_lock.lock();
+    found = design_find(kind, mul, div, size);
+    design_lock.unlock();
+
+    if(found)
+        return &found->design;
+
+    memset(&design, 0, sizeof(design));
+    design.kind = kind;
+    design.mul = mul;
+    design.div = div;
+    design.size = size;
+
+    switch(kind) {
+    case designBand:
+        band_design(&design);
+        break;
+    case designFraction:
+        fraction_design(&design);
+        break;
+    default:
+        polyphase_design(&design);
+        break;
+    }
+
+    design_lock.lock();
+    found = design_find(kind, mul, div, size);
+    if(!found) {
+        found = new designed(&designs);
+        found->design = design;
+        design.bank = NULL;
+        design.steps = NULL;
+    }
+    design_lock.unlock();
+
+    if(design.bank)
+        delete[] design.bank;
+    if(design.steps)
+        delete[] design.steps;
+
+    return &found->design;
+}
+
+class __LOCAL resampler
+{
+public:
+    virtual ~resampler() {}
+
+    virtual size_t process(Audio::Linear from, Audio::Linear dest, size_t count) = 0;
+};
+
+static inline Audio::Sample band_clip(long long value)
+{
+    if(value > 32767)
+        return 32767;
+    if(value < -32768)
+        return -32768;
+    return (Audio::Sample)value;
+}
+
+// channels are kept as planes of history so each inner product stays a
+// contiguous run of taps; one phase step is shared by every channel.
+
+static void band_split(Audio::Sample *planes, unsigned stride, const Audio::Sample *from, unsigned frames, unsigned channels)
+{
+    unsigned pos, channel;
+
+    if(channels == 1) {
+        memcpy(planes, from, frames * sizeof(Audio::Sample));
+        return;
+    }
+
+    for(pos = 0; pos < frames; ++pos) {
+        for(channel = 0; channel < channels; ++channel)
+            planes[channel * stride + pos] = *(from++);
+    }
+}
+
+template<unsigned F>
+class __LOCAL interpolator : public resampler
+{
+private:
+    const Audio::Sample *bank;
+    Audio::Sample *history;
+    unsigned channels, fill;
+
+public:
+    interpolator(unsigned count);
+    ~interpolator();
+
+    size_t process(Audio::Linear from, Audio::Linear dest, size_t count) __FINAL;
+};
+
+template<unsigned F>
+interpolator<F>::interpolator(unsigned count)
+{
+    channels = count;
+    bank = design_get(designBand, F, 1, BAND_TAPS)->bank;
+    history = new Audio::Sample[channels * (BAND_TAPS - 1 + RESAMPLE_CHUNK)];
+    memset(history, 0, channels * (BAND_TAPS - 1 + RESAMPLE_CHUNK) * sizeof(Audio::Sample));
+    fill = BAND_TAPS - 1;
+}
+
+template<unsigned F>
+interpolator<F>::~interpolator()
+{
+    delete[] history;
+}
+
+template<unsigned F>
+size_t interpolator<F>::process(Audio::Linear from, Audio::Linear dest, size_t count)
+{
+    const unsigned size = BAND_TAPS - 1 + RESAMPLE_CHUNK;
+    size_t saved = count * F;
+    const Audio::Sample *window;
+    unsigned copy, pos, phase, channel;
+
+    while(count) {
+        if(fill == size) {
+            for(channel = 0; channel < channels; ++channel)
+                memmove(history + channel * size, history + channel * size + RESAMPLE_CHUNK, (BAND_TAPS - 1) * sizeof(Audio::Sample));
+            fill = BAND_TAPS - 1;
+        }
+        copy = size - fill;
+        if(copy > count)
+            copy = (unsigned)count;
+
+        band_split(history + fill, size, from, copy, channels);
+        window = history + fill + 1 - BAND_TAPS;
+        for(pos = 0; pos < copy; ++pos) {
+            for(channel = 0; channel < channels; ++channel)
+                *(dest++) = window[channel * size + BAND_TAPS / 2 - 1];
+            for(phase = 1; phase < F; ++phase) {
+                for(channel = 0; channel < channels; ++channel)
+                    *(dest++) = band_clip(((long long)resample_dot(window + channel * size, bank + (phase - 1) * BAND_TAPS, BAND_TAPS) + 16384) >> 15);
+            }
+            ++window;
+        }
+        fill += copy;
+        from += copy * channels;
+        count -= copy;
+    }
+    return saved;
+}
+
+template<unsigned F>
+class __LOCAL decimator : public resampler
+{
+private:
+    const Audio::Sample *bank;
+    Audio::Sample *streams;
+    Audio::Sample *group;
+    unsigned channels, fill, cycle;
+
+    unsigned append(const Audio::Sample *from, unsigned groups, Audio::Linear dest);
+
+public:
+    decimator(unsigned count);
+    ~decimator();
+
+    size_t process(Audio::Linear from, Audio::Linear dest, size_t count) __FINAL;
+};
+
+template<unsigned F>
+decimator<F>::decimator(unsigned count)
+{
+    channels = count;
+    bank = design_get(designBand, F, 1, BAND_TAPS)->bank;
+    streams = new Audio::Sample[channels * F * (BAND_TAPS + RESAMPLE_CHUNK)];
+    group = new Audio::Sample[channels * F];
+    memset(streams, 0, channels * F * (BAND_TAPS + RESAMPLE_CHUNK) * sizeof(Audio::Sample));
+    fill = BAND_TAPS;
+    cycle = 0;
+}
+
+template<unsigned F>
+decimator<F>::~decimator()
+{
+    delete[] streams;
+    delete[] group;
+}
+
+template<unsigned F>
+unsigned decimator<F>::append(const Audio::Sample *from, unsigned groups, Audio::Linear dest)
+{
+    const unsigned size = BAND_TAPS + RESAMPLE_CHUNK;
+    unsigned pos, phase, channel;
+    const Audio::Sample *plane;
+    long long sum;
+
+    if(fill == size) {
+        for(phase = 0; phase < F * channels; ++phase)
+            memmove(streams + phase * size, streams + phase * size + RESAMPLE_CHUNK, BAND_TAPS * sizeof(Audio::Sample));
+        fill = BAND_TAPS;
+    }
+    if(groups > size - fill)
+        groups = size - fill;
+
+    for(pos = 0; pos < groups; ++pos) {
+        for(phase = 0; phase < F; ++phase) {
+            for(channel = 0; channel < channels; ++channel)
+                streams[(channel * F + phase) * size + fill + pos] = *(from++);
+        }
+    }
+
+    for(pos = 0; pos < groups; ++pos) {
+        ++fill;
+        for(channel = 0; channel < channels; ++channel) {
+            plane = streams + channel * F * size;
+            sum = (long long)plane[fill - BAND_TAPS / 2] << 15;
+            for(phase = 1; phase < F; ++phase)
+                sum += resample_dot(plane + (F - phase) * size + fill - BAND_TAPS, bank + (phase - 1) * BAND_TAPS, BAND_TAPS);
+            *(dest++) = band_clip((sum + F * 16384) / (F * 32768));
+        }
+    }
+    return groups;
+}
+
+template<unsigned F>
+size_t decimator<F>::process(Audio::Linear from, Audio::Linear dest, size_t count)
+{
+    size_t saved = 0;
+    unsigned groups, channel;
+
+    while(cycle && count) {
+        for(channel = 0; channel < channels; ++channel)
+            group[cycle * channels + channel] = *(from++);
+        --count;
+        if(++cycle == F) {
+            cycle = 0;
+            saved += append(group, 1, dest);
+        }
+    }
+
+    while(count >= F) {
+        groups = append(from, (unsigned)(count / F), dest + saved * channels);
+        saved += groups;
+        from += groups * F * channels;
+        count -= groups * F;
+    }
+
+    while(count--) {
+        for(channel = 0; channel < channels; ++channel)
+            group[cycle * channels + channel] = *(from++);
+        ++cycle;
+    }
+
+    return saved;
+}
+
+template<class FIRST, class SECOND>
+class __LOCAL bandcascade : public resampler
+{
+private:
+    FIRST first;
+    SECOND second;
+    Audio::Sample *scratch;
+    unsigned channels;
+
+public:
+    bandcascade(unsigned count);
+    ~bandcascade();
+
+    size_t process(Audio::Linear from, Audio::Linear dest, size_t count) __FINAL;
+};
+
+template<class FIRST, class SECOND>
+bandcascade<FIRST, SECOND>::bandcascade(unsigned count) :
+first(count), second(count)
+{
+    channels = count;
+    scratch = new Audio::Sample[RESAMPLE_CHUNK * 2 * channels];
+}
+
+template<class FIRST, class SECOND>
+bandcascade<FIRST, SECOND>::~bandcascade()
+{
+    delete[] scratch;
+}
+
+template<class FIRST, class SECOND>
+size_t bandcascade<FIRST, SECOND>::process(Audio::Linear from, Audio::Linear dest, size_t count)
+{
+    size_t saved = 0, copy, used;
+
+    while(count) {
+        copy = count;
+        if(copy > RESAMPLE_CHUNK)
+            copy = RESAMPLE_CHUNK;
+
+        used = first.process(from, scratch, copy);
+        saved += second.process(scratch, dest + saved * channels, used);
+        from += copy * channels;
+        count -= copy;
+    }
+    return saved;
+}
+
+static resampler *band_select(unsigned mul, unsigned div, unsigned channels)
+{
+    if(div == 1) {
+        switch(mul) {
+        case 2:
+            return new interpolator<2>(channels);
+        case 3:
+            return new interpolator<3>(channels);
+        case 6:
+            return new bandcascade< interpolator<2>, interpolator<3> >(channels);
+        }
+    }
+    else if(mul == 1) {
+        switch(div) {
+        case 2:
+            return new decimator<2>(channels);
+        case 3:
+            return new decimator<3>(channels);
+        case 6:
+            return new bandcascade< decimator<3>, decimator<2> >(channels);
+        }
+    }
+    return NULL;
+}
+
+// ratios without a band fast path, such as 8000 to 6000 or 44100 to
+// 8000 (80/441), run a fractional phase accumulator instead of stepping
+// through the full upsampled rate.  The position is 32.32 fixed point,
+// so state is bounded by the tap count and never by the ratio, and the
+// cost follows the output rate.  Coefficients for FRACTION_PHASES + 1
+// fractional delays are precomputed and adjacent phases are blended.
+
+class __LOCAL fractional : public resampler
+{
+private:
+    unsigned taps, channels, fill, offset;
+    unsigned long long step, position;
+    const Audio::Sample *bank;
+    Audio::Sample *history;
+
+public:
+    fractional(unsigned mul, unsigned div, unsigned count);
+    ~fractional();
+
+    size_t process(Audio::Linear from, Audio::Linear dest, size_t count) __FINAL;
+};
+
+fractional::fractional(unsigned mul, unsigned div, unsigned count)
+{
+    const design_t *design = design_get(designFraction, mul, div, FRACTION_TAPS);
+
+    taps = design->taps;
+    bank = design->bank;
+    channels = count;
+    history = new Audio::Sample[channels * (taps + RESAMPLE_CHUNK)];
+
+    step = ((unsigned long long)div << 32) / mul;
+    position = 0;
+    offset = 0;
+    memset(history, 0, channels * (taps + RESAMPLE_CHUNK) * sizeof(Audio::Sample));
+    fill = taps - 1;
+}
+
+fractional::~fractional()
+{
+    delete[] history;
+}
+
+size_t fractional::process(Audio::Linear from, Audio::Linear dest, size_t count)
+{
+    const unsigned size = taps + RESAMPLE_CHUNK;
+    size_t saved = 0;
+    unsigned copy, phase, channel;
+    const Audio::Sample *coef, *window;
+    int low, high, mu;
+
+    while(count) {
+        copy = size - fill;
+        if(copy > count)
+            copy = (unsigned)count;
+
+        band_split(history + fill, size, from, copy, channels);
+        fill += copy;
+        from += copy * channels;
+        count -= copy;
+
+        while(offset + taps <= fill) {
+            phase = (unsigned)(position >> (32 - FRACTION_BITS));
+            mu = (int)((position >> (32 - FRACTION_BITS - 15)) & 0x7fff);
+            coef = bank + phase * taps;
+            for(channel = 0; channel < channels; ++channel) {
+                window = history + channel * size + offset;
+                low = (resample_dot(window, coef, taps) + 16384) >> 15;
+                high = (resample_dot(window, coef + taps, taps) + 16384) >> 15;
+                *(dest++) = band_clip(low + (((long long)(high - low) * mu) >> 15));
+            }
+            ++saved;
+            position += step;
+            offset += (unsigned)(position >> 32);
+            position &= 0xffffffffull;
+        }
+
+        if(offset >= fill) {
+            offset -= fill;
+            fill = 0;
+        }
+        else {
+            for(channel = 0; channel < channels; ++channel)
+                memmove(history + channel * size, history + channel * size + offset, (fill - offset) * sizeof(Audio::Sample));
+            fill -= offset;
+            offset = 0;
+        }
+    }
+    return saved;
+}
+
+AudioResample::AudioResample(Rate div, Rate mul, unsigned count)
 {
     bool common = true;
     while(common) {
@@ -58,15 +695,29 @@ AudioResample::AudioResample(Rate div, Rate mul)
         max = dfact;
 
     ++max;
-    buffer = new Sample[max];
     ppos = gpos = 0;
-    memset(buffer, 0, max * 2);
     last = 0;
+    buffer = NULL;
+    channels = count ? count : 1;
+
+    // only an unchanged rate is left to the copying loop below
+    fast = band_select(mfact, dfact, channels);
+    if(!fast && mfact != dfact)
+        fast = new fractional(mfact, dfact, channels);
+
+    if(fast)
+        return;
+
+    buffer = new Sample[max];
+    memset(buffer, 0, max * 2);
 }
 
 AudioResample::~AudioResample()
 {
-    delete[] buffer;
+    if(buffer)
+        delete[] buffer;
+    if(fast)
+        delete (resampler *)fast;
 }
 
 size_t AudioResample::estimate(size_t count)
@@ -83,6 +734,15 @@ size_t AudioResample::process(Linear from, Linear dest, size_t count)
     unsigned pos;
     unsigned dpos;
 
+    if(fast)
+        return ((resampler *)fast)->process(from, dest, count);
+
+    // an unchanged rate is a copy of whole frames at any channel count
+    if(mfact == dfact) {
+        memmove(dest, from, count * channels * sizeof(Sample));
+        return count;
+    }
+
     while(count--) {
         current = *(from++);
         diff = (current - last) / mfact;
@@ -110,4 +770,109 @@ size_t AudioResample::process(Linear from, Linear dest, size_t count)
     return saved;
 }
 
+// polyphase windowed sinc resampling.  The prototype lowpass is cut a
+// little below the narrower nyquist of the two rates and split into one
+// q15 coefficient bank per phase, stored reversed so every output sample
+// is a forward inner product over a window of buffered input.  Taps per
+// phase are a multiple of 8 so the inner product never has a tail.
+
+AudioPolyphase::AudioPolyphase(Rate div, Rate mul, unsigned size)
+{
+    unsigned a = (unsigned)mul, b = (unsigned)div, t;
+    const design_t *design;
+
+    bank = NULL;
+    history = NULL;
+    steps = NULL;
+    mfact = dfact = 1;
+    taps = fill = offset = current = 0;
+
+    if(!a || !b)
+        return;
+
+    while(b) {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+
+    mfact = (unsigned)mul / a;
+    dfact = (unsigned)div / a;
+
+    if(mfact == 1 && dfact == 1)
+        return;
+
+    if(!size)
+        size = RESAMPLE_TAPS;
+
+    design = design_get(designPolyphase, mfact, dfact, size);
+    taps = design->taps;
+    bank = design->bank;
+    steps = design->steps;
+
+    history = new Sample[taps + RESAMPLE_CHUNK];
+    memset(history, 0, (taps - 1) * sizeof(Sample));
+    fill = taps - 1;
+}
+
+AudioPolyphase::~AudioPolyphase()
+{
+    if(history)
+        delete[] history;
+}
+
+size_t AudioPolyphase::estimate(size_t count)
+{
+    count *= mfact;
+    count += (mfact - 1);
+    return (count / dfact) + 1;
+}
+
+size_t AudioPolyphase::process(Linear from, Linear dest, size_t count)
+{
+    size_t saved = 0;
+    unsigned copy;
+    int sample;
+
+    if(!bank) {
+        memcpy(dest, from, count * sizeof(Sample));
+        return count;
+    }
+
+    while(count) {
+        copy = taps + RESAMPLE_CHUNK - fill;
+        if(copy > count)
+            copy = (unsigned)count;
+
+        memcpy(history + fill, from, copy * sizeof(Sample));
+        fill += copy;
+        from += copy;
+        count -= copy;
+
+        while(offset + taps <= fill) {
+            sample = resample_dot(history + offset, bank + current * taps, taps);
+            sample = (sample + 16384) >> 15;
+            if(sample > 32767)
+                sample = 32767;
+            else if(sample < -32768)
+                sample = -32768;
+            *(dest++) = (Sample)sample;
+            ++saved;
+            offset += steps[current * 2];
+            current = steps[current * 2 + 1];
+        }
+
+        if(offset >= fill) {
+            offset -= fill;
+            fill = 0;
+        }
+        else {
+            memmove(history, history + offset, (fill - offset) * sizeof(Sample));
+            fill -= offset;
+            offset = 0;
+        }
+    }
+    return saved;
+}
+
 } // namespace ucommon